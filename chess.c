@@ -5,22 +5,100 @@
     - Jogador humano joga com as brancas por padrão; você pode trocar.
     - Entrada de jogada: "e2e4" ou "e2 e4" (sem aspas). Para promoção, ao mover o peão para última rank
       o programa pedirá qual peça escolher (Q/R/B/N).
+    - Compilar: gcc -O2 -pthread chess.c -o chess
+    - Opções: --depth N, --time MS, --threads N, --hash MB, --nodes N, --deterministic, --no-numa,
+      --slo MS, --min-scale F, --min-depth N (orçamento adaptativo sob carga),
+      --skill 0..20 (níveis abaixo de 20 limitam nós e sorteiam entre jogadas próximas),
+      --fill-attacks (peças deslizantes e cheques por preenchimento Kogge-Stone com AVX2),
+      --mtdf (raiz por MTD(f), sempre em uma thread: ignora --threads; com --skill abaixo de 20
+        usa a busca normal, que dá os scores por jogada do sorteio)
+      --incremental-moves (experimental: jogadas por peça em cache, regeradas só onde o lance tocou)
+      --policy ARQUIVO [--policy-min-depth N] (ordena jogadas quietas pela rede de política),
+      --policy-data ARQUIVO (grava a melhor jogada quieta de cada nó como alvo de treino)
+      --dedup ARQUIVO [--dedup-capacity N] [--dedup-fp P] (filtro aproximado de posições já vistas,
+        mantido entre execuções; usado por --mine e --policy-data)
+      (--threads 1 mantém a busca inteira na thread principal)
+      (sem --threads/--hash, os padrões vêm dos limites de CPU e memória do contêiner)
+    - Modos: --bench-dispatch (latência do pool de threads de busca),
+      --bench-read ARQUIVO (vazão de leitura: stdio x io_uring x read; --no-uring desliga o io_uring),
+      --bench-dedup N [--dedup-fp P] (vazão e falsos positivos do filtro de dedup com N chaves),
+      --server CAMINHO | --server-tcp PORTA (servidor de análise com pedidos em pipeline),
+      --distribute host:porta,... [--fen FEN] (raiz dividida entre servidores trabalhadores),
+      --dist-bench N (sobe N trabalhadores locais e mede tempo até a profundidade),
+      --epd ARQUIVO [--epd-jobs N] (suíte tática bm/am com tempo até a solução),
+      --compare-mtdf [--corpus ARQUIVO] (nós e tempo do MTD(f) contra a busca atual),
+      --bench-threads N [--corpus ARQUIVO] [--bench-json ARQUIVO] (escalabilidade com 1, 2, 4... N
+        threads: ganho de NPS e de tempo até a profundidade, sobrecarga de busca, disputa do hash),
+      --bench-movegen [--perft N] [--corpus ARQUIVO] (geração incremental x completa: perft e busca),
+      --policy-train DADOS --policy-out ARQUIVO [--policy-epochs N] (treina a rede de política),
+      --annotate ARQUIVO [--fen FEN] (anota a partida inteira: scores, melhor lance, erros),
+      --analyze [--fen FEN] [--checkpoint ARQUIVO [--checkpoint-interval S] [--checkpoint-hash] [--resume]]
+        (análise longa com estado retomável),
+      --mine ARQUIVO --mine-out SAIDA [--mine-filter-depth N] [--mine-filter-threads N]
+        [--mine-verify-threads N] (minera problemas táticos em partidas PGN)
+    - Métricas (formato Prometheus): --metrics-port PORTA (HTTP em 127.0.0.1) e/ou
+      --metrics-file CAMINHO [--metrics-interval MS]
+    - Gravador de voo das últimas buscas: comando 'flight' ou kill -USR1 <pid> (em stderr)
 */
 
+#define _GNU_SOURCE /* afinidade de threads (NUMA) */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
 
 #define BOARD_SIZE 8
 
 /* Configuráveis */
-int AI_DEPTH = 3; /* profundidade do minimax (melhore desempenho vs força) */
+int AI_DEPTH = 3; /* profundidade máxima do minimax (melhore desempenho vs força) */
+int AI_TIME_MS = 3000; /* orçamento de tempo por jogada em ms (0 = sem limite) */
+int AI_STABLE_ITERS = 2; /* iterações seguidas com a mesma melhor jogada para encerrar cedo */
+int AI_STABLE_MARGIN = 20; /* variação de score (centipeões) ainda considerada estável */
+int AI_STABLE_MIN_DEPTH = 4; /* profundidade mínima completada antes da parada por estabilidade (no máximo AI_DEPTH - 1) */
+int AI_RECAPTURE_MARGIN = 300; /* vantagem mínima de uma captura rasa para jogar de imediato */
+int AI_THREADS = 1; /* threads de busca (1 = busca na própria thread; no main, padrão = CPUs do contêiner) */
+int AI_HASH_MB = 16; /* tamanho da tabela de transposição (no main, padrão derivado da memória do contêiner) */
+int AI_DETERMINISTIC = 0; /* resultados reprodutíveis: sem relógio, divisão fixa, hash limpo */
+long long AI_NODES = 0; /* orçamento de nós por busca (0 = sem limite) */
+int AI_SLO_MS = 0; /* latência-alvo por busca sob carga (0 = controlador de carga desligado) */
+double AI_LOAD_MIN_SCALE = 0.1; /* piso de qualidade: fração mínima do orçamento de tempo/nós */
+int AI_LOAD_MIN_DEPTH = 2; /* piso de qualidade: profundidade sempre completada */
+int AI_SKILL = 20; /* nível 0..SKILL_MAX; abaixo do máximo: orçamento de nós pequeno + sorteio */
+int AI_MTDF = 0; /* raiz por MTD(f) (janelas nulas sucessivas) em vez das janelas cheias por jogada */
+int AI_FILL_ATTACKS = 0; /* ataques de peças deslizantes por preenchimento Kogge-Stone (AVX2) em vez de laços por raio */
+int AI_INCREMENTAL_MOVES = 0; /* experimental: listas de jogadas por peça em cache, regeradas só onde o lance tocou */
+int AI_POLICY_MIN_DEPTH = 3; /* profundidade restante mínima para ordenar quietas pela política (--policy) */
+int AI_NUMA = 1; /* fixa threads por nó NUMA e inicializa o hash em paralelo (se houver >1 nó) */
 
 /* Tabuleiro: [rank][file] com 0,0 = a8 e 7,7 = h1 para facilitar impressão */
 typedef struct {
     char cell[BOARD_SIZE][BOARD_SIZE];
+    int halfmove; /* meios-lances desde a última captura ou lance de peão (regra dos 50 lances) */
 } Board;
 
 /* Representa um movimento */
@@ -64,6 +142,7 @@ void init_board(Board *bd) {
         "RNBQKBNR"  /* rank 1 */
     };
     for (int r=0;r<8;r++) for (int f=0;f<8;f++) bd->cell[r][f] = init[r][f];
+    bd->halfmove = 0;
 }
 
 /* Imprime o tabuleiro de forma legível */
@@ -96,6 +175,7 @@ int alg_to_coords(const char *s, int *r, int *f) {
 /* Copia tabuleiro */
 void copy_board(Board *dst, Board *src) {
     memcpy(dst->cell, src->cell, BOARD_SIZE*BOARD_SIZE);
+    dst->halfmove = src->halfmove;
 }
 
 /* Verifica limites */
@@ -103,6 +183,134 @@ int in_bounds(int r, int f) {
     return r >= 0 && r < 8 && f >= 0 && f < 8;
 }
 
+/* Ataques por preenchimento (Kogge-Stone), sem tabelas: as casas viram bitboards (bit r*8+f)
+   por comparação de bytes, e os raios das oito direções de todas as torres, bispos e damas de
+   um lado saem de uma vez, quatro direções por registrador AVX2. Sem AVX2 na CPU, o mesmo
+   preenchimento roda direção a direção. Usado quando AI_FILL_ATTACKS está ligado. */
+#define BB_NOT_A  0xFEFEFEFEFEFEFEFEULL
+#define BB_NOT_H  0x7F7F7F7F7F7F7F7FULL
+#define BB_NOT_AB 0xFCFCFCFCFCFCFCFCULL
+#define BB_NOT_GH 0x3F3F3F3F3F3F3F3FULL
+
+/* Direções em ordem de lane: as quatro primeiras deslocam para bits maiores (r ou f crescem) */
+enum { DIR_S, DIR_E, DIR_SE, DIR_SW, DIR_N, DIR_W, DIR_NE, DIR_NW };
+static const int dir_shift[8] = {8, 1, 9, 7, 8, 1, 7, 9};
+static const unsigned long long dir_mask[8] = {~0ULL, BB_NOT_A, BB_NOT_A, BB_NOT_H, ~0ULL, BB_NOT_H, BB_NOT_A, BB_NOT_H};
+
+#if defined(__x86_64__) || defined(__i386__)
+/* Casas cujo caractere está em [lo, hi] */
+__attribute__((target("avx2")))
+static unsigned long long cells_mask_avx2(Board *bd, char lo, char hi) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)&bd->cell[0][0]);
+    __m256i b = _mm256_loadu_si256((const __m256i *)&bd->cell[4][0]);
+    __m256i l = _mm256_set1_epi8(lo - 1), h = _mm256_set1_epi8(hi + 1);
+    __m256i ia = _mm256_and_si256(_mm256_cmpgt_epi8(a, l), _mm256_cmpgt_epi8(h, a));
+    __m256i ib = _mm256_and_si256(_mm256_cmpgt_epi8(b, l), _mm256_cmpgt_epi8(h, b));
+    return (unsigned)_mm256_movemask_epi8(ia) | (unsigned long long)(unsigned)_mm256_movemask_epi8(ib) << 32;
+}
+
+__attribute__((target("avx2")))
+static void slider_fill_avx2(unsigned long long orth, unsigned long long diag, unsigned long long empty, unsigned long long *ray) {
+    __m256i gen = _mm256_set_epi64x(diag, diag, orth, orth);
+    __m256i e = _mm256_set1_epi64x(empty);
+    /* lanes 0..3: S, E, SE, SW (<<); N, W, NE, NW (>>) */
+    __m256i ml = _mm256_set_epi64x(BB_NOT_H, BB_NOT_A, BB_NOT_A, ~0ULL);
+    __m256i mr = _mm256_set_epi64x(BB_NOT_H, BB_NOT_A, BB_NOT_H, ~0ULL);
+    __m256i s1l = _mm256_set_epi64x(7, 9, 1, 8), s1r = _mm256_set_epi64x(9, 7, 1, 8);
+    __m256i s2l = _mm256_add_epi64(s1l, s1l), s4l = _mm256_add_epi64(s2l, s2l);
+    __m256i s2r = _mm256_add_epi64(s1r, s1r), s4r = _mm256_add_epi64(s2r, s2r);
+    __m256i gl = gen, pl = _mm256_and_si256(e, ml);
+    __m256i gr = gen, pr = _mm256_and_si256(e, mr);
+    gl = _mm256_or_si256(gl, _mm256_and_si256(pl, _mm256_sllv_epi64(gl, s1l)));
+    gr = _mm256_or_si256(gr, _mm256_and_si256(pr, _mm256_srlv_epi64(gr, s1r)));
+    pl = _mm256_and_si256(pl, _mm256_sllv_epi64(pl, s1l));
+    pr = _mm256_and_si256(pr, _mm256_srlv_epi64(pr, s1r));
+    gl = _mm256_or_si256(gl, _mm256_and_si256(pl, _mm256_sllv_epi64(gl, s2l)));
+    gr = _mm256_or_si256(gr, _mm256_and_si256(pr, _mm256_srlv_epi64(gr, s2r)));
+    pl = _mm256_and_si256(pl, _mm256_sllv_epi64(pl, s2l));
+    pr = _mm256_and_si256(pr, _mm256_srlv_epi64(pr, s2r));
+    gl = _mm256_or_si256(gl, _mm256_and_si256(pl, _mm256_sllv_epi64(gl, s4l)));
+    gr = _mm256_or_si256(gr, _mm256_and_si256(pr, _mm256_srlv_epi64(gr, s4r)));
+    _mm256_storeu_si256((__m256i *)ray, _mm256_and_si256(_mm256_sllv_epi64(gl, s1l), ml));
+    _mm256_storeu_si256((__m256i *)(ray + 4), _mm256_and_si256(_mm256_srlv_epi64(gr, s1r), mr));
+}
+#endif
+
+static unsigned long long cells_mask_scalar(Board *bd, char lo, char hi) {
+    unsigned long long m = 0;
+    const char *c = &bd->cell[0][0];
+    for (int sq=0;sq<64;sq++) if (c[sq] >= lo && c[sq] <= hi) m |= 1ULL << sq;
+    return m;
+}
+
+static void slider_fill_scalar(unsigned long long orth, unsigned long long diag, unsigned long long empty, unsigned long long *ray) {
+    for (int d=0;d<8;d++) {
+        unsigned long long gen = (d == DIR_S || d == DIR_E || d == DIR_N || d == DIR_W) ? orth : diag;
+        unsigned long long pro = empty & dir_mask[d];
+        int s = dir_shift[d], left = d < 4;
+        for (int k=0;k<3;k++, s *= 2) {
+            gen |= pro & (left ? gen << s : gen >> s);
+            pro &= left ? pro << s : pro >> s;
+        }
+        ray[d] = (left ? gen << dir_shift[d] : gen >> dir_shift[d]) & dir_mask[d];
+    }
+}
+
+/* AVX2 disponível? Detectado uma vez; fora de x86 só há os caminhos escalares */
+#if defined(__x86_64__) || defined(__i386__)
+static int have_avx2 = -1;
+#else
+static int have_avx2 = 0;
+#endif
+
+int avx2_available(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (have_avx2 < 0) have_avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    return have_avx2;
+}
+
+unsigned long long cells_mask(Board *bd, char lo, char hi) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (avx2_available()) return cells_mask_avx2(bd, lo, hi);
+#endif
+    return cells_mask_scalar(bd, lo, hi);
+}
+
+/* Raios de ataque por direção das peças ortogonais (orth) e diagonais (diag) */
+void slider_attacks(unsigned long long orth, unsigned long long diag, unsigned long long empty, unsigned long long *ray) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (avx2_available()) { slider_fill_avx2(orth, diag, empty, ray); return; }
+#endif
+    slider_fill_scalar(orth, diag, empty, ray);
+}
+
+/* Todas as casas atacadas pelo lado white */
+unsigned long long side_attacks(Board *bd, int white) {
+    char up = white ? 0 : 'a' - 'A';
+    unsigned long long empty = cells_mask(bd, '.', '.');
+    unsigned long long q = cells_mask(bd, 'Q' + up, 'Q' + up);
+    unsigned long long ray[8], att = 0;
+    slider_attacks(cells_mask(bd, 'R' + up, 'R' + up) | q, cells_mask(bd, 'B' + up, 'B' + up) | q, empty, ray);
+    for (int d=0;d<8;d++) att |= ray[d];
+    unsigned long long n = cells_mask(bd, 'N' + up, 'N' + up);
+    att |= ((n << 17) & BB_NOT_A) | ((n << 15) & BB_NOT_H) | ((n >> 15) & BB_NOT_A) | ((n >> 17) & BB_NOT_H)
+         | ((n << 10) & BB_NOT_AB) | ((n << 6) & BB_NOT_GH) | ((n >> 6) & BB_NOT_AB) | ((n >> 10) & BB_NOT_GH);
+    unsigned long long k = cells_mask(bd, 'K' + up, 'K' + up);
+    k |= (k << 8) | (k >> 8);
+    att |= k | ((k << 1) & BB_NOT_A) | ((k >> 1) & BB_NOT_H);
+    unsigned long long p = cells_mask(bd, 'P' + up, 'P' + up);
+    if (white) att |= ((p >> 9) & BB_NOT_H) | ((p >> 7) & BB_NOT_A); /* brancas sobem: r diminui */
+    else att |= ((p << 7) & BB_NOT_H) | ((p << 9) & BB_NOT_A);
+    return att;
+}
+
+/* Cheque pelo mapa de ataques do adversário; rei ausente conta como cheque */
+int fill_in_check(Board *bd, int white_turn) {
+    unsigned long long king = white_turn ? cells_mask(bd, 'K', 'K') : cells_mask(bd, 'k', 'k');
+    return !king || (side_attacks(bd, !white_turn) & king) != 0;
+}
+
 /* Gera movimentos pseudo-legais para uma peça localizada em (r,f) */
 int generate_piece_moves(Board *bd, int r, int f, Move *out, int max_out, int white_turn) {
     /* retorna número de movimentos gerados (pode incluir movimentos que deixem rei em cheque; filtragem posterior) */
@@ -167,6 +375,22 @@ int generate_piece_moves(Board *bd, int r, int f, Move *out, int max_out, int wh
     }
 
     /* Sliding pieces: Rook, Bishop, Queen */
+    if (AI_FILL_ATTACKS) {
+        /* mesmos destinos e mesma ordem dos laços abaixo: direção a direção, da casa mais próxima */
+        static const int order[8] = {DIR_S, DIR_N, DIR_E, DIR_W, DIR_SE, DIR_SW, DIR_NE, DIR_NW};
+        unsigned long long bit = 1ULL << (r*8+f), ray[8];
+        unsigned long long own = is_white(p) ? cells_mask(bd, 'A', 'Z') : cells_mask(bd, 'a', 'z');
+        slider_attacks(toupper(p) != 'B' ? bit : 0, toupper(p) != 'R' ? bit : 0, cells_mask(bd, '.', '.'), ray);
+        for (int k=0;k<8;k++) {
+            unsigned long long t = ray[order[k]] & ~own;
+            while (t && count < max_out) {
+                int sq = order[k] < DIR_N ? __builtin_ctzll(t) : 63 - __builtin_clzll(t);
+                t &= ~(1ULL << sq);
+                out[count++] = (Move){r,f,sq/8,sq%8,'\0'};
+            }
+        }
+        return count;
+    }
     int rook_dirs[4][2] = {{1,0},{-1,0},{0,1},{0,-1}};
     int bishop_dirs[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
     if (toupper(p) == 'R' || toupper(p) == 'Q') {
@@ -206,21 +430,9 @@ int generate_piece_moves(Board *bd, int r, int f, Move *out, int max_out, int wh
     return count;
 }
 
-/* Gera todos os movimentos legais do jogador (filtra movimentos que deixam o rei em cheque) */
+/* Filtra por legalidade (rei não em cheque após o movimento) */
 #define MAX_MOVES 256
-int generate_legal_moves(Board *bd, Move *out, int white_turn) {
-    Move all[MAX_MOVES];
-    int alln = 0;
-    /* gerar pseudo-legal */
-    for (int r=0;r<8;r++) for (int f=0;f<8;f++) {
-        char p = bd->cell[r][f];
-        if (p == '.') continue;
-        if (white_turn && !is_white(p)) continue;
-        if (!white_turn && !is_black(p)) continue;
-        alln += generate_piece_moves(bd, r, f, all + alln, MAX_MOVES - alln, white_turn);
-        if (alln >= MAX_MOVES) break;
-    }
-    /* filtrar por legalidade (rei não em cheque após o movimento) */
+int filter_legal_moves(Board *bd, Move *all, int alln, Move *out, int white_turn) {
     int count = 0;
     Board tmp;
     for (int i=0;i<alln;i++) {
@@ -238,6 +450,10 @@ int generate_legal_moves(Board *bd, Move *out, int white_turn) {
         }
         /* check if own king is in check */
         int in_check = 0;
+        if (AI_FILL_ATTACKS) {
+            if (!fill_in_check(&tmp, white_turn) && count < MAX_MOVES) out[count++] = all[i];
+            continue;
+        }
         /* find king */
         int kr=-1,kf=-1;
         char kingChar = white_turn ? 'K' : 'k';
@@ -269,9 +485,28 @@ int generate_legal_moves(Board *bd, Move *out, int white_turn) {
     return count;
 }
 
+/* Gera todos os movimentos legais do jogador (filtra movimentos que deixam o rei em cheque) */
+int generate_legal_moves(Board *bd, Move *out, int white_turn) {
+    Move all[MAX_MOVES];
+    int alln = 0;
+    /* gerar pseudo-legal */
+    for (int r=0;r<8;r++) for (int f=0;f<8;f++) {
+        char p = bd->cell[r][f];
+        if (p == '.') continue;
+        if (white_turn && !is_white(p)) continue;
+        if (!white_turn && !is_black(p)) continue;
+        alln += generate_piece_moves(bd, r, f, all + alln, MAX_MOVES - alln, white_turn);
+        if (alln >= MAX_MOVES) break;
+    }
+    return filter_legal_moves(bd, all, alln, out, white_turn);
+}
+
 /* Executa um movimento no tabuleiro (assume legal) */
 void apply_move(Board *bd, Move m) {
     char mover = bd->cell[m.r1][m.f1];
+    /* relógio dos 50 lances: zera em captura ou lance de peão */
+    if (toupper(mover) == 'P' || bd->cell[m.r2][m.f2] != '.') bd->halfmove = 0;
+    else bd->halfmove++;
     bd->cell[m.r1][m.f1] = '.';
     if (toupper(mover) == 'P' && (m.r2 == 0 || m.r2 == 7) && m.promotion != '\0') {
         char prom = m.promotion;
@@ -285,6 +520,153 @@ void apply_move(Board *bd, Move m) {
     }
 }
 
+/* Listas de jogadas incrementais (experimental, --incremental-moves): para cada casa ocupada,
+   os destinos pseudo-legais da peça (bitboard, bit r*8+f) e as casas de que eles dependem
+   (raios até o primeiro bloqueador, casas do padrão de cavalo/rei, casas de avanço e captura
+   do peão). Depois de um lance só as peças cujas dependências contêm a origem ou o destino
+   são regeradas. As jogadas saem na mesma ordem de generate_piece_moves, então a busca
+   visita exatamente a mesma árvore. */
+typedef struct {
+    unsigned long long occ;        /* casas ocupadas */
+    unsigned long long targets[64];
+    unsigned long long deps[64];
+} MoveCache;
+
+static unsigned long long mc_ray[8][64];  /* raio vazio por direção (DIR_*) e casa */
+static unsigned long long mc_knight[64], mc_king[64];
+static int mc_ready = 0;
+static const int mc_dr[8] = {1, 0, 1, 1, -1, 0, -1, -1}; /* DIR_S, DIR_E, DIR_SE, DIR_SW, DIR_N, DIR_W, DIR_NE, DIR_NW */
+static const int mc_df[8] = {0, 1, 1, -1, 0, -1, 1, -1};
+static const int mc_order[8] = {DIR_S, DIR_N, DIR_E, DIR_W, DIR_SE, DIR_SW, DIR_NE, DIR_NW}; /* torre, depois bispo */
+
+static void mc_init(void) {
+    for (int sq=0;sq<64;sq++) {
+        int r = sq / 8, f = sq % 8;
+        for (int d=0;d<8;d++) {
+            for (int rr=r+mc_dr[d], ff=f+mc_df[d]; in_bounds(rr,ff); rr+=mc_dr[d], ff+=mc_df[d]) mc_ray[d][sq] |= 1ULL << (rr*8+ff);
+        }
+        for (int dr=-2;dr<=2;dr++) for (int df=-2;df<=2;df++) {
+            if (!in_bounds(r+dr, f+df)) continue;
+            if (dr*dr + df*df == 5) mc_knight[sq] |= 1ULL << ((r+dr)*8+f+df);
+            if (dr*dr + df*df <= 2 && (dr || df)) mc_king[sq] |= 1ULL << ((r+dr)*8+f+df);
+        }
+    }
+    mc_ready = 1;
+}
+
+/* Destinos e dependências da peça em sq (casa vazia: ambos zerados) */
+static void mc_piece(MoveCache *mc, Board *bd, int sq) {
+    int r = sq / 8, f = sq % 8;
+    char p = bd->cell[r][f];
+    unsigned long long t = 0, dep = 0;
+    if (p == '.') { mc->targets[sq] = mc->deps[sq] = 0; return; }
+    char up = toupper(p);
+    if (up == 'P') {
+        int step = is_white(p) ? -1 : 1, r1 = r + step;
+        if (in_bounds(r1, f)) {
+            dep |= 1ULL << (r1*8+f);
+            if (bd->cell[r1][f] == '.') {
+                t |= 1ULL << (r1*8+f);
+                int r2 = r + 2*step;
+                if (r == (is_white(p) ? 6 : 1) && in_bounds(r2, f)) {
+                    dep |= 1ULL << (r2*8+f);
+                    if (bd->cell[r2][f] == '.') t |= 1ULL << (r2*8+f);
+                }
+            }
+            for (int df=-1;df<=1;df+=2) {
+                if (!in_bounds(r1, f+df)) continue;
+                char c = bd->cell[r1][f+df];
+                dep |= 1ULL << (r1*8+f+df);
+                if (c != '.' && !same_color(p, c)) t |= 1ULL << (r1*8+f+df);
+            }
+        }
+    } else if (up == 'N' || up == 'K') {
+        dep = up == 'N' ? mc_knight[sq] : mc_king[sq];
+        for (unsigned long long s = dep; s; s &= s - 1) {
+            int q = __builtin_ctzll(s);
+            char c = bd->cell[q/8][q%8];
+            if (c == '.' || !same_color(p, c)) t |= 1ULL << q;
+        }
+    } else {
+        for (int d=0;d<8;d++) {
+            int orth = d == DIR_S || d == DIR_E || d == DIR_N || d == DIR_W;
+            if (orth ? up == 'B' : up == 'R') continue;
+            for (int rr=r+mc_dr[d], ff=f+mc_df[d]; in_bounds(rr,ff); rr+=mc_dr[d], ff+=mc_df[d]) {
+                char c = bd->cell[rr][ff];
+                dep |= 1ULL << (rr*8+ff);
+                if (c == '.') { t |= 1ULL << (rr*8+ff); continue; }
+                if (!same_color(p, c)) t |= 1ULL << (rr*8+ff);
+                break;
+            }
+        }
+    }
+    mc->targets[sq] = t;
+    mc->deps[sq] = dep;
+}
+
+void movecache_build(MoveCache *mc, Board *bd) {
+    if (!mc_ready) mc_init();
+    mc->occ = 0;
+    for (int sq=0;sq<64;sq++) {
+        if (bd->cell[sq/8][sq%8] != '.') mc->occ |= 1ULL << sq;
+        mc_piece(mc, bd, sq);
+    }
+}
+
+/* Cache do filho a partir do pai; bd já tem o lance m aplicado */
+void movecache_update(MoveCache *dst, const MoveCache *src, Board *bd, Move m) {
+    int from = m.r1*8+m.f1, to = m.r2*8+m.f2;
+    unsigned long long touched = 1ULL << from | 1ULL << to;
+    unsigned long long redo = touched;
+    for (unsigned long long s = src->occ & ~touched; s; s &= s - 1) {
+        int q = __builtin_ctzll(s);
+        if (src->deps[q] & touched) redo |= 1ULL << q;
+    }
+    memcpy(dst, src, sizeof *dst);
+    dst->occ = (src->occ & ~(1ULL << from)) | 1ULL << to;
+    for (; redo; redo &= redo - 1) mc_piece(dst, bd, __builtin_ctzll(redo));
+}
+
+/* Jogadas pseudo-legais do lado, na ordem de generate_piece_moves e, como lá, cortadas em
+   max_out (posições artificiais com muitas damas passam de MAX_MOVES) */
+int movecache_pseudo_moves(MoveCache *mc, Board *bd, Move *out, int max_out, int white_turn) {
+    int n = 0;
+    for (unsigned long long s = mc->occ; s && n < max_out; s &= s - 1) {
+        int sq = __builtin_ctzll(s), r = sq / 8, f = sq % 8;
+        char p = bd->cell[r][f];
+        if (white_turn ? !is_white(p) : !is_black(p)) continue;
+        unsigned long long t = mc->targets[sq];
+        char up = toupper(p);
+        if (up == 'P') {
+            int step = is_white(p) ? -8 : 8;
+            int cand[4] = {sq + step, sq + 2*step, sq + step - 1, sq + step + 1};
+            for (int k=0;k<4;k++) {
+                int q = cand[k];
+                if (q >= 0 && q < 64 && (t >> q & 1) && n < max_out) out[n++] = (Move){r,f,q/8,q%8,'\0'};
+            }
+        } else if (up == 'N' || up == 'K') {
+            for (; t && n < max_out; t &= t - 1) { int q = __builtin_ctzll(t); out[n++] = (Move){r,f,q/8,q%8,'\0'}; }
+        } else {
+            for (int k=0;k<8;k++) {
+                int d = mc_order[k];
+                unsigned long long rt = t & mc_ray[d][sq];
+                while (rt && n < max_out) {
+                    int q = d < DIR_N ? __builtin_ctzll(rt) : 63 - __builtin_clzll(rt);
+                    rt &= ~(1ULL << q);
+                    out[n++] = (Move){r,f,q/8,q%8,'\0'};
+                }
+            }
+        }
+    }
+    return n;
+}
+
+int movecache_legal_moves(MoveCache *mc, Board *bd, Move *out, int white_turn) {
+    Move all[MAX_MOVES];
+    int alln = movecache_pseudo_moves(mc, bd, all, MAX_MOVES, white_turn);
+    return filter_legal_moves(bd, all, alln, out, white_turn);
+}
+
 /* Avaliação de material simples: soma valores das peças (brancas positivas, pretas negativas) */
 int evaluate_board(Board *bd) {
     int score = 0;
@@ -298,8 +680,22 @@ int evaluate_board(Board *bd) {
     return score;
 }
 
+/* Material insuficiente para mate: K x K, K+menor x K, ou só bispos na mesma cor de casa */
+int insufficient_material(Board *bd) {
+    int minors = 0, knights = 0, bishop_colors = 0; /* bit 0: casas claras, bit 1: escuras */
+    for (int r=0;r<8;r++) for (int f=0;f<8;f++) {
+        char p = toupper(bd->cell[r][f]);
+        if (p == 'P' || p == 'R' || p == 'Q') return 0;
+        if (p == 'N') { minors++; knights++; }
+        if (p == 'B') { minors++; bishop_colors |= ((r + f) & 1) ? 2 : 1; }
+    }
+    if (minors <= 1) return 1;
+    return knights == 0 && bishop_colors != 3;
+}
+
 /* Checa se jogador (white_turn) está em cheque */
 int is_in_check(Board *bd, int white_turn) {
+    if (AI_FILL_ATTACKS) return fill_in_check(bd, white_turn);
     char kingChar = white_turn ? 'K' : 'k';
     int kr=-1,kf=-1;
     for (int r=0;r<8;r++) for (int f=0;f<8;f++) if (bd->cell[r][f] == kingChar) { kr=r; kf=f; }
@@ -318,11 +714,610 @@ int is_in_check(Board *bd, int white_turn) {
     return 0;
 }
 
+/* Hash Zobrist da posição (peças + lado a jogar); chaves geradas por splitmix64 */
+unsigned long long zobrist_piece[12][64];
+unsigned long long zobrist_black;
+int zobrist_ready = 0;
+
+unsigned long long splitmix64(unsigned long long *state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void init_zobrist(void) {
+    unsigned long long st = 0x4D617465436865ULL;
+    for (int p=0;p<12;p++) for (int sq=0;sq<64;sq++) zobrist_piece[p][sq] = splitmix64(&st);
+    zobrist_black = splitmix64(&st);
+    zobrist_ready = 1;
+}
+
+/* Índice 0..11 da peça ("PNBRQKpnbrqk") ou -1 para casa vazia */
+int piece_index(char p) {
+    const char *pieces = "PNBRQKpnbrqk";
+    const char *q = p != '.' && p ? strchr(pieces, p) : NULL;
+    return q ? (int)(q - pieces) : -1;
+}
+
+unsigned long long board_hash(Board *bd, int white_turn) {
+    if (!zobrist_ready) init_zobrist();
+    unsigned long long h = white_turn ? 0 : zobrist_black;
+    for (int r=0;r<8;r++) for (int f=0;f<8;f++) {
+        int pi = piece_index(bd->cell[r][f]);
+        if (pi >= 0) h ^= zobrist_piece[pi][r*8+f];
+    }
+    return h;
+}
+
+/* Simetrias do tabuleiro. Sem roque nem en-passant, o espelho das colunas é sempre válido;
+   a troca de cores espelha as fileiras, inverte maiúsculas/minúsculas e o lado a jogar.
+   As duas são involuções que comutam, então cada transformação é a própria inversa. */
+#define SYM_FLIP_COLOR 1
+#define SYM_MIRROR_FILE 2
+
+void transform_board(Board *dst, Board *src, int t) {
+    for (int r=0;r<8;r++) for (int f=0;f<8;f++) {
+        char p = src->cell[r][f];
+        int rr = (t & SYM_FLIP_COLOR) ? 7 - r : r;
+        int ff = (t & SYM_MIRROR_FILE) ? 7 - f : f;
+        if ((t & SYM_FLIP_COLOR) && p != '.') p = is_white(p) ? tolower(p) : toupper(p);
+        dst->cell[rr][ff] = p;
+    }
+    dst->halfmove = src->halfmove;
+}
+
+Move transform_move(Move m, int t) {
+    if (t & SYM_FLIP_COLOR) { m.r1 = 7 - m.r1; m.r2 = 7 - m.r2; }
+    if (t & SYM_MIRROR_FILE) { m.f1 = 7 - m.f1; m.f2 = 7 - m.f2; }
+    return m;
+}
+
+/* Representante canônico da classe de simetria: o menor (lado a jogar, casas) entre as
+   quatro imagens; o canônico tem sempre as brancas a jogar. Retorna a transformação usada,
+   que também leva jogadas do canônico de volta à posição original (transform_move). */
+int canonicalize_board(Board *bd, int white_turn, Board *out) {
+    int best_t = -1;
+    Board img;
+    for (int t=0;t<4;t++) {
+        int stm_white = (t & SYM_FLIP_COLOR) ? !white_turn : white_turn;
+        if (!stm_white) continue;
+        transform_board(&img, bd, t);
+        if (best_t < 0 || memcmp(img.cell, out->cell, sizeof img.cell) < 0) {
+            copy_board(out, &img);
+            best_t = t;
+        }
+    }
+    return best_t;
+}
+
+/* Hash da classe de simetria da posição (mesmo valor para todas as imagens) */
+unsigned long long canonical_hash(Board *bd, int white_turn, int *t) {
+    Board canon;
+    int tt = canonicalize_board(bd, white_turn, &canon);
+    if (t) *t = tt;
+    return board_hash(&canon, 1);
+}
+
+/* Relógio monotônico em milissegundos / nanossegundos */
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Compara dois movimentos (origem/destino/promo) */
+int moves_equal(Move a, Move b) {
+    return a.r1==b.r1 && a.f1==b.f1 && a.r2==b.r2 && a.f2==b.f2 && a.promotion==b.promotion;
+}
+
+/* Tabela de transposição compartilhada (sem trava: a chave é gravada como key ^ data,
+   então uma entrada rasgada por escrita concorrente simplesmente não confere). Cada entrada
+   leva a geração em que foi gravada; entradas de outra geração valem como vazias. */
+#define TT_EXACT 0
+#define TT_LOWER 1 /* score >= valor real não provado: limite inferior */
+#define TT_UPPER 2 /* limite superior */
+typedef struct {
+    unsigned long long key;
+    unsigned long long data; /* score:32 | depth:8 | flag:2 | move:15 | geração:7 */
+} TTEntry;
+#define TT_MAX_GENERATION 127
+
+TTEntry *tt_table = NULL;
+unsigned long long tt_entries = 0; /* potência de 2 */
+int tt_needs_touch = 0; /* precisa ser zerada pelas threads antes da próxima busca */
+int tt_generation = 1;  /* 1..TT_MAX_GENERATION; nunca 0, então data != 0 em entradas gravadas */
+
+/* (Re)aloca a tabela com até AI_HASH_MB megabytes. A memória não é zerada aqui: a primeira
+   busca zera cada região na thread que vai usá-la, para que as páginas fiquem no nó NUMA dela. */
+void tt_resize(int mb) {
+    unsigned long long bytes = (unsigned long long)(mb > 0 ? mb : 1) << 20;
+    unsigned long long n = 1;
+    while (n * 2 * sizeof(TTEntry) <= bytes) n *= 2;
+    free(tt_table);
+    tt_table = malloc(n * sizeof(TTEntry));
+    if (!tt_table) { fprintf(stderr, "Sem memoria para a tabela de hash (%d MB)\n", mb); exit(1); }
+    tt_entries = n;
+    tt_needs_touch = 1;
+}
+
+/* Nova partida: invalida logicamente todas as entradas em O(1). Quando o contador dá a
+   volta, entradas antigas poderiam voltar a valer, então a tabela é zerada por completo. */
+void tt_new_generation(void) {
+    if (++tt_generation > TT_MAX_GENERATION) {
+        tt_generation = 1;
+        tt_needs_touch = 1;
+    }
+}
+
+/* Codifica jogada em 15 bits: origem 6, destino 6, promoção 3 */
+unsigned encode_move(Move m) {
+    const char *proms = "QRBN";
+    const char *q = m.promotion ? strchr(proms, toupper((unsigned char)m.promotion)) : NULL;
+    unsigned pi = q ? (unsigned)(q - proms) + 1 : 0;
+    return (unsigned)(m.r1*8 + m.f1) | (unsigned)(m.r2*8 + m.f2) << 6 | pi << 12;
+}
+
+Move decode_move(unsigned v) {
+    Move m;
+    m.r1 = (v & 63) / 8; m.f1 = (v & 63) % 8;
+    m.r2 = ((v >> 6) & 63) / 8; m.f2 = ((v >> 6) & 63) % 8;
+    m.promotion = ((v >> 12) & 7) ? "QRBN"[((v >> 12) & 7) - 1] : '\0';
+    return m;
+}
+
+/* Tabelas de ordenação de cada thread; alocadas e zeradas pela própria thread depois de
+   fixada no seu nó NUMA, e mantidas entre buscas */
+#define MAX_PLY 64
+typedef struct {
+    Move killers[MAX_PLY][2]; /* jogadas quietas que causaram corte, por profundidade restante */
+    int history[2][64][64];   /* [lado][origem][destino] */
+} ThreadTables;
+
+/* Estado de uma thread de busca */
+typedef struct {
+    int id;
+    int node;             /* nó NUMA em que a thread roda */
+    int pinned;           /* nó + 1 em que a thread já foi fixada (0 = nenhum) */
+    ThreadTables *local;
+    long long nodes;
+    long long node_limit; /* 0 = sem limite (acumulado na busca inteira) */
+    long long deadline;   /* instante (ms) em que a busca é abortada; 0 = sem limite */
+    int aborted;
+    TTEntry *tt;          /* tabela inteira, ou a fatia própria no modo determinístico */
+    unsigned long long tt_mask;
+    long long tt_probes, tt_hits; /* por busca, somados às métricas no fim */
+    long long tt_stores, tt_evictions; /* gravações e despejos de entrada viva de outra posição */
+    long long busy_ns;    /* tempo dentro de search_root nesta busca */
+    MoveCache *mc;        /* pilha de caches por ply (--incremental-moves), alocada no primeiro uso */
+    int mc_ply;
+    int mc_inherit;       /* o pai deixou em mc[mc_ply - 1] o cache da posição anterior */
+    Move mc_move;         /* ...e o lance que leva a esta */
+} SearchThread;
+
+/* Filtro de duplicatas aproximado para fluxos de posições (--dedup ARQUIVO): Bloom em blocos
+   de 512 bits, uma linha de cache por chave, chaveado pelo hash canônico da posição (as
+   simetrias contam como a mesma). Dimensionado por --dedup-capacity e --dedup-fp; inserções
+   concorrentes por fetch_or atômico, sem trava; gravado no fim do processo e recarregado na
+   próxima execução, então a deduplicação vale entre rodadas. Falso positivo descarta uma
+   posição nova; nunca deixa passar uma repetida (exceto duas inserções simultâneas da mesma). */
+#define DEDUP_MAGIC "XDEDUP01"
+#define DEDUP_BLOCK_WORDS 8
+typedef struct {
+    char magic[8];
+    unsigned long long blocks;
+    int k;
+    long long capacity;
+    double fp;
+    long long inserted;
+} DedupHeader;
+
+struct {
+    _Atomic unsigned long long *words;
+    unsigned long long blocks;
+    int k;
+    long long capacity;
+    double fp;
+    atomic_llong inserted, duplicates;
+} dedup;
+const char *dedup_path = NULL;          /* --dedup ARQUIVO */
+long long dedup_capacity = 100000000;   /* --dedup-capacity N (posições esperadas) */
+double dedup_fp = 0.001;                /* --dedup-fp P (taxa de falsos positivos alvo) */
+
+/* log2 sem libm: parte inteira por divisões e a fração bit a bit por quadrados sucessivos */
+static double dedup_log2(double x) {
+    double r = 0, bit = 0.5;
+    while (x < 1) { x *= 2; r -= 1; }
+    while (x >= 2) { x /= 2; r += 1; }
+    for (int i=0;i<30;i++, bit /= 2) {
+        x *= x;
+        if (x >= 2) { x /= 2; r += bit; }
+    }
+    return r;
+}
+
+static int dedup_alloc(unsigned long long blocks) {
+    void *p = mmap(NULL, blocks * DEDUP_BLOCK_WORDS * 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return 0;
+    dedup.words = p;
+    dedup.blocks = blocks;
+    return 1;
+}
+
+/* Bloom clássico: log2(1/p) / ln 2 bits por chave e k = bits por chave * ln 2. Os blocos
+   pioram a taxa, e mais quanto maior o k: 10% a mais de bits em p = 1% e mais 3% por bit de
+   log2(1/p) além disso deixam a taxa medida (--bench-dedup) abaixo do alvo */
+int dedup_create(long long capacity, double fp) {
+    if (capacity < 1) capacity = 1;
+    if (fp <= 0 || fp >= 1) fp = 0.001;
+    double lg = -dedup_log2(fp);
+    double bpk = lg * 1.4426950 * (1.1 + 0.03 * (lg - 6.6));
+    int k = (int)(bpk * 0.6931472 + 0.5);
+    dedup.k = k < 1 ? 1 : k > 16 ? 16 : k;
+    dedup.capacity = capacity;
+    dedup.fp = fp;
+    return dedup_alloc(((unsigned long long)(capacity * bpk) + 511) / 512);
+}
+
+/* Testa a chave e, com insert, grava seus bits; devolve 1 se era nova (algum bit apagado) */
+int dedup_test(unsigned long long key, int insert) {
+    unsigned long long h = key;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    _Atomic unsigned long long *b = dedup.words + (unsigned long long)(((unsigned __int128)h * dedup.blocks) >> 64) * DEDUP_BLOCK_WORDS;
+    unsigned long long mask[DEDUP_BLOCK_WORDS] = {0}, g = h * 0x9E3779B97F4A7C15ULL + key;
+    for (int i=0;i<dedup.k;i++) {
+        unsigned idx = (unsigned)(g >> 55); /* 9 bits: palavra (3) e bit (6) */
+        mask[idx >> 6] |= 1ULL << (idx & 63);
+        g = g * 0x5851F42D4C957F2DULL + 0x14057B7EF767814FULL;
+    }
+    int fresh = 0;
+    for (int w=0;w<DEDUP_BLOCK_WORDS;w++) {
+        if (mask[w] && (atomic_load_explicit(&b[w], memory_order_relaxed) & mask[w]) != mask[w]) { fresh = 1; break; }
+    }
+    if (!fresh || !insert) return fresh;
+    fresh = 0;
+    for (int w=0;w<DEDUP_BLOCK_WORDS;w++) {
+        if (!mask[w]) continue;
+        unsigned long long old = atomic_fetch_or_explicit(&b[w], mask[w], memory_order_relaxed);
+        if ((old & mask[w]) != mask[w]) fresh = 1;
+    }
+    if (fresh) atomic_fetch_add_explicit(&dedup.inserted, 1, memory_order_relaxed);
+    return fresh;
+}
+
+/* Posição ainda não vista? (e passa a ser); sem filtro configurado, toda posição é nova */
+int dedup_position(Board *bd, int white_turn) {
+    if (!dedup.words) return 1;
+    if (dedup_test(canonical_hash(bd, white_turn, NULL), 1)) return 1;
+    atomic_fetch_add_explicit(&dedup.duplicates, 1, memory_order_relaxed);
+    return 0;
+}
+
+/* Lê o filtro gravado por dedup_save; o cabeçalho só vale se k estiver em 1..16 e o número
+   de blocos bater com o tamanho do arquivo. Em qualquer falha nada fica alocado. */
+int dedup_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    DedupHeader h;
+    struct stat stt;
+    if (!f) return 0;
+    unsigned long long body = 0, block_bytes = DEDUP_BLOCK_WORDS * 8;
+    int ok = fread(&h, sizeof h, 1, f) == 1 && !memcmp(h.magic, DEDUP_MAGIC, 8) && h.k >= 1 && h.k <= 16 &&
+             fstat(fileno(f), &stt) == 0 && (unsigned long long)stt.st_size > sizeof h;
+    if (ok) body = (unsigned long long)stt.st_size - sizeof h;
+    ok = ok && h.blocks && body % block_bytes == 0 && body / block_bytes == h.blocks && dedup_alloc(h.blocks);
+    if (ok && fread((void *)dedup.words, block_bytes, h.blocks, f) != h.blocks) {
+        munmap((void *)dedup.words, h.blocks * block_bytes);
+        dedup.words = NULL;
+        dedup.blocks = 0;
+        ok = 0;
+    }
+    fclose(f);
+    if (!ok) return 0;
+    dedup.k = h.k;
+    dedup.capacity = h.capacity;
+    dedup.fp = h.fp;
+    atomic_store(&dedup.inserted, h.inserted);
+    return 1;
+}
+
+/* Arquivo temporário e rename, como o checkpoint */
+void dedup_save(void) {
+    if (!dedup.words || !dedup_path) return;
+    char tmp[4096];
+    snprintf(tmp, sizeof tmp, "%s.tmp", dedup_path);
+    FILE *f = fopen(tmp, "wb");
+    DedupHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, DEDUP_MAGIC, 8);
+    h.blocks = dedup.blocks;
+    h.k = dedup.k;
+    h.capacity = dedup.capacity;
+    h.fp = dedup.fp;
+    h.inserted = atomic_load(&dedup.inserted);
+    if (!f) { fprintf(stderr, "Nao foi possivel gravar %s\n", tmp); return; }
+    int ok = fwrite(&h, sizeof h, 1, f) == 1 && fwrite((void *)dedup.words, DEDUP_BLOCK_WORDS * 8, dedup.blocks, f) == dedup.blocks;
+    if (fclose(f) != 0 || !ok || rename(tmp, dedup_path) != 0) { fprintf(stderr, "Nao foi possivel gravar %s\n", dedup_path); return; }
+    fprintf(stderr, "Dedup: %lld posicoes no filtro, %lld duplicatas nesta execucao (%s)\n",
+            (long long)atomic_load(&dedup.inserted), (long long)atomic_load(&dedup.duplicates), dedup_path);
+}
+
+/* Abre ou cria o filtro de --dedup; gravado por atexit */
+int dedup_open(void) {
+    if (!dedup_path) return 1;
+    if (dedup_load(dedup_path)) {
+        fprintf(stderr, "Dedup: %s carregado (%llu KB, k=%d, %lld posicoes)\n", dedup_path,
+                dedup.blocks * DEDUP_BLOCK_WORDS * 8 >> 10, dedup.k, (long long)atomic_load(&dedup.inserted));
+    } else if (access(dedup_path, F_OK) == 0) {
+        fprintf(stderr, "Filtro de dedup invalido: %s\n", dedup_path);
+        return 0;
+    } else if (!dedup_create(dedup_capacity, dedup_fp)) {
+        fprintf(stderr, "Sem memoria para o filtro de dedup\n");
+        return 0;
+    }
+    atexit(dedup_save);
+    return 1;
+}
+
+/* Política aprendida para ordenar jogadas quietas: rede de uma camada oculta sobre as peças
+   (12 x 64 casas, vistas do lado a jogar) e uma linha de saída por par origem-destino. Pesos
+   quantizados em ponto fixo Q6 (int16 na entrada, int8 na saída), lidos de --policy ARQUIVO;
+   a inferência usa AVX2 quando a CPU tem, com o mesmo resultado no caminho escalar. */
+#define POLICY_FEATURES 768
+#define POLICY_HIDDEN 32
+#define POLICY_MOVES 4096
+#define POLICY_SHIFT 6
+#define POLICY_MAGIC "XPOLICY1"
+typedef struct {
+    short w1[POLICY_FEATURES][POLICY_HIDDEN];
+    short b1[POLICY_HIDDEN];
+    signed char w2[POLICY_MOVES][POLICY_HIDDEN];
+} PolicyNet;
+PolicyNet *policy_net = NULL;
+const char *policy_file = NULL; /* --policy ARQUIVO */
+
+/* Casa vista do lado a jogar: as pretas enxergam o tabuleiro espelhado nas fileiras */
+static inline int policy_square(int r, int f, int side) { return (side ? r : 7 - r) * 8 + f; }
+
+static inline int policy_move_index(Move m, int side) {
+    return policy_square(m.r1, m.f1, side) * 64 + policy_square(m.r2, m.f2, side);
+}
+
+/* Entradas ativas (peça própria = 0..5, adversária = 6..11); devolve quantas */
+int policy_features(Board *bd, int side, int *feat) {
+    int n = 0;
+    for (int r=0;r<8;r++) for (int f=0;f<8;f++) {
+        int pi = piece_index(bd->cell[r][f]);
+        if (pi < 0) continue;
+        if (!side) pi = pi < 6 ? pi + 6 : pi - 6;
+        feat[n++] = pi * 64 + policy_square(r, f, side);
+    }
+    return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void policy_hidden_avx2(const int *feat, int nf, short *h) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)policy_net->b1);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(policy_net->b1 + 16));
+    for (int i=0;i<nf;i++) {
+        const short *w = policy_net->w1[feat[i]];
+        a0 = _mm256_adds_epi16(a0, _mm256_loadu_si256((const __m256i *)w));
+        a1 = _mm256_adds_epi16(a1, _mm256_loadu_si256((const __m256i *)(w + 16)));
+    }
+    _mm256_storeu_si256((__m256i *)h, _mm256_max_epi16(a0, _mm256_setzero_si256()));
+    _mm256_storeu_si256((__m256i *)(h + 16), _mm256_max_epi16(a1, _mm256_setzero_si256()));
+}
+
+__attribute__((target("avx2")))
+static int policy_dot_avx2(const short *h, const signed char *w) {
+    __m256i w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)w));
+    __m256i w1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(w + 16)));
+    __m256i s = _mm256_add_epi32(_mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)h), w0),
+                                 _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(h + 16)), w1));
+    __m128i t = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    t = _mm_add_epi32(t, _mm_shuffle_epi32(t, 0x4E));
+    t = _mm_add_epi32(t, _mm_shuffle_epi32(t, 0xB1));
+    return _mm_cvtsi128_si32(t);
+}
+#endif
+
+/* Soma saturada em int16, como _mm256_adds_epi16 */
+static void policy_hidden_scalar(const int *feat, int nf, short *h) {
+    for (int j=0;j<POLICY_HIDDEN;j++) {
+        int a = policy_net->b1[j];
+        for (int i=0;i<nf;i++) {
+            a += policy_net->w1[feat[i]][j];
+            a = a > SHRT_MAX ? SHRT_MAX : a < SHRT_MIN ? SHRT_MIN : a;
+        }
+        h[j] = a > 0 ? a : 0;
+    }
+}
+
+static int policy_dot_scalar(const short *h, const signed char *w) {
+    int s = 0;
+    for (int j=0;j<POLICY_HIDDEN;j++) s += h[j] * w[j];
+    return s;
+}
+
+/* Camada oculta da posição (Q6, após ReLU); calculada uma vez por nó */
+void policy_hidden(Board *bd, int side, short *h) {
+    int feat[64];
+    int nf = policy_features(bd, side, feat);
+#if defined(__x86_64__) || defined(__i386__)
+    if (avx2_available()) { policy_hidden_avx2(feat, nf, h); return; }
+#endif
+    policy_hidden_scalar(feat, nf, h);
+}
+
+/* Logit da jogada em Q6 */
+int policy_logit(const short *h, Move m, int side) {
+    const signed char *w = policy_net->w2[policy_move_index(m, side)];
+#if defined(__x86_64__) || defined(__i386__)
+    if (avx2_available()) return policy_dot_avx2(h, w) >> POLICY_SHIFT;
+#endif
+    return policy_dot_scalar(h, w) >> POLICY_SHIFT;
+}
+
+int policy_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    char magic[8];
+    if (!f) return 0;
+    PolicyNet *net = malloc(sizeof *net);
+    int ok = fread(magic, 1, 8, f) == 8 && !memcmp(magic, POLICY_MAGIC, 8) && fread(net, sizeof *net, 1, f) == 1;
+    fclose(f);
+    if (!ok) { free(net); return 0; }
+    policy_net = net;
+    return 1;
+}
+
+/* Alvos de treino: em nós com profundidade restante >= AI_POLICY_MIN_DEPTH que não falharam
+   baixo, a melhor jogada quieta é gravada com a posição (--policy-data ARQUIVO) */
+typedef struct {
+    char cell[64];
+    char white_turn;
+    char r1, f1, r2, f2, promotion;
+    char pad[2];
+} PolicySample;
+const char *policy_data_file = NULL; /* --policy-data ARQUIVO (acrescenta) */
+FILE *policy_data = NULL;
+pthread_mutex_t policy_data_lock = PTHREAD_MUTEX_INITIALIZER;
+long long policy_samples_written = 0;
+
+void policy_record(Board *bd, int side, Move m) {
+    if (bd->cell[m.r2][m.f2] != '.' || !dedup_position(bd, side)) return;
+    PolicySample s;
+    memset(&s, 0, sizeof s);
+    memcpy(s.cell, bd->cell, 64);
+    s.white_turn = side;
+    s.r1 = m.r1; s.f1 = m.f1; s.r2 = m.r2; s.f2 = m.f2; s.promotion = m.promotion;
+    pthread_mutex_lock(&policy_data_lock);
+    fwrite(&s, sizeof s, 1, policy_data);
+    policy_samples_written++;
+    pthread_mutex_unlock(&policy_data_lock);
+}
+
+/* Ordena jogadas: jogada do hash, capturas (MVV-LVA), killers e histórico (ou a política,
+   nas quietas, com profundidade restante suficiente) */
+void order_moves(SearchThread *st, Board *bd, Move *moves, int n, int depth, int side, Move *tt_move) {
+    int keys[MAX_MOVES];
+    ThreadTables *lt = st->local;
+    int kd = depth < MAX_PLY ? depth : MAX_PLY - 1;
+    short hidden[POLICY_HIDDEN];
+    int use_policy = policy_net && depth >= AI_POLICY_MIN_DEPTH;
+    if (use_policy) policy_hidden(bd, side, hidden);
+    for (int i=0;i<n;i++) {
+        Move m = moves[i];
+        char victim = bd->cell[m.r2][m.f2];
+        int k;
+        if (tt_move && moves_equal(m, *tt_move)) k = 1 << 30;
+        else if (victim != '.') k = 1000000 + piece_value(victim) * 10 - piece_value(bd->cell[m.r1][m.f1]) / 100;
+        else if (moves_equal(m, lt->killers[kd][0])) k = 900000;
+        else if (moves_equal(m, lt->killers[kd][1])) k = 800000;
+        else if (use_policy) {
+            int l = policy_logit(hidden, m, side);
+            k = 400000 + (l > 399999 ? 399999 : l < -399999 ? -399999 : l);
+        }
+        else k = lt->history[side][m.r1*8+m.f1][m.r2*8+m.f2];
+        keys[i] = k;
+    }
+    for (int i=1;i<n;i++) {
+        Move m = moves[i];
+        int k = keys[i], j = i - 1;
+        while (j >= 0 && keys[j] < k) { moves[j+1] = moves[j]; keys[j+1] = keys[j]; j--; }
+        moves[j+1] = m; keys[j+1] = k;
+    }
+}
+
+/* Registra corte beta de jogada quieta nas killers e no histórico */
+void note_cutoff(SearchThread *st, Board *bd, Move m, int depth, int side) {
+    if (bd->cell[m.r2][m.f2] != '.') return;
+    ThreadTables *lt = st->local;
+    int kd = depth < MAX_PLY ? depth : MAX_PLY - 1;
+    if (!moves_equal(m, lt->killers[kd][0])) {
+        lt->killers[kd][1] = lt->killers[kd][0];
+        lt->killers[kd][0] = m;
+    }
+    int *h = &lt->history[side][m.r1*8+m.f1][m.r2*8+m.f2];
+    *h += depth * depth;
+    if (*h > 700000) {
+        for (int a=0;a<64;a++) for (int b=0;b<64;b++) lt->history[side][a][b] /= 2;
+    }
+}
+
+int tt_probe(SearchThread *st, unsigned long long key, int *score, int *depth, int *flag, Move *m) {
+    TTEntry *e = &st->tt[key & st->tt_mask];
+    unsigned long long data = e->data;
+    st->tt_probes++;
+    if ((e->key ^ data) != key || (int)(data >> 57) != tt_generation) return 0;
+    st->tt_hits++;
+    *score = (int)(unsigned)(data & 0xFFFFFFFFULL);
+    *depth = (int)((data >> 32) & 0xFF);
+    *flag = (int)((data >> 40) & 3);
+    *m = decode_move((unsigned)(data >> 42) & 0x7FFF);
+    return 1;
+}
+
+void tt_store(SearchThread *st, unsigned long long key, int score, int depth, int flag, Move m) {
+    TTEntry *e = &st->tt[key & st->tt_mask];
+    unsigned long long old = e->data;
+    int live = (int)(old >> 57) == tt_generation;
+    /* substitui se for outra posição, de geração antiga, ou se a nova busca for ao menos tão profunda */
+    if ((e->key ^ old) == key && live && (int)((old >> 32) & 0xFF) > depth) return;
+    st->tt_stores++;
+    if (live && (e->key ^ old) != key) st->tt_evictions++;
+    unsigned long long data = (unsigned long long)(unsigned)score
+                            | (unsigned long long)(depth & 0xFF) << 32
+                            | (unsigned long long)flag << 40
+                            | (unsigned long long)encode_move(m) << 42
+                            | (unsigned long long)tt_generation << 57;
+    e->data = data;
+    e->key = key ^ data;
+}
+
 /* Minimax com poda alfa-beta; retorna avaliação (pontuação orientada para as brancas) */
-int minimax(Board *bd, int depth, int alpha, int beta, int maximizingPlayer) {
+int minimax(SearchThread *st, Board *bd, int depth, int alpha, int beta, int maximizingPlayer) {
+    int inherit = st->mc_inherit;
+    st->mc_inherit = 0;
+    /* limites rígidos: nós a cada chamada, relógio a cada 1024 nós */
+    st->nodes++;
+    if (st->node_limit && st->nodes >= st->node_limit) st->aborted = 1;
+    if (st->deadline && (st->nodes & 1023) == 0 && now_ms() >= st->deadline) st->aborted = 1;
+    if (st->aborted) return 0;
+    /* empate por regra dos 50 lances ou material insuficiente: poda a subárvore inteira */
+    if (bd->halfmove >= 100 || insufficient_material(bd)) return 0;
+    /* tabela de transposição: corte por limite guardado e jogada para ordenar primeiro */
+    unsigned long long key = board_hash(bd, maximizingPlayer);
+    int tt_score, tt_depth, tt_flag, has_tt_move = 0;
+    Move tt_move;
+    if (tt_probe(st, key, &tt_score, &tt_depth, &tt_flag, &tt_move)) {
+        if (tt_depth >= depth) {
+            if (tt_flag == TT_EXACT) return tt_score;
+            if (tt_flag == TT_LOWER && tt_score >= beta) return tt_score;
+            if (tt_flag == TT_UPPER && tt_score <= alpha) return tt_score;
+        }
+        has_tt_move = 1;
+    }
     /* Depth 0 ou fim de jogo? */
     Move moves[MAX_MOVES];
-    int n = generate_legal_moves(bd, moves, maximizingPlayer);
+    MoveCache *mc = NULL;
+    int n;
+    if (AI_INCREMENTAL_MOVES && st->mc_ply < MAX_PLY) {
+        if (!st->mc) st->mc = malloc(MAX_PLY * sizeof(MoveCache));
+        mc = &st->mc[st->mc_ply];
+        if (inherit) movecache_update(mc, mc - 1, bd, st->mc_move);
+        else movecache_build(mc, bd);
+        n = movecache_legal_moves(mc, bd, moves, maximizingPlayer);
+    } else {
+        n = generate_legal_moves(bd, moves, maximizingPlayer);
+    }
     if (depth == 0 || n == 0) {
         /* if no moves: checkmate or stalemate - determine */
         if (n == 0) {
@@ -337,18 +1332,28 @@ int minimax(Board *bd, int depth, int alpha, int beta, int maximizingPlayer) {
         }
         return evaluate_board(bd);
     }
+    order_moves(st, bd, moves, n, depth, maximizingPlayer, has_tt_move ? &tt_move : NULL);
 
+    int alpha0 = alpha, beta0 = beta;
+    Move bestMove = moves[0];
     if (maximizingPlayer) {
         int maxEval = INT_MIN;
         Board tmp;
         for (int i=0;i<n;i++) {
             copy_board(&tmp, bd);
             apply_move(&tmp, moves[i]);
-            int eval = minimax(&tmp, depth-1, alpha, beta, 0);
-            if (eval > maxEval) maxEval = eval;
+            st->mc_inherit = mc != NULL;
+            st->mc_move = moves[i];
+            st->mc_ply++;
+            int eval = minimax(st, &tmp, depth-1, alpha, beta, 0);
+            st->mc_ply--;
+            if (st->aborted) return 0;
+            if (eval > maxEval) { maxEval = eval; bestMove = moves[i]; }
             if (eval > alpha) alpha = eval;
-            if (beta <= alpha) break;
+            if (beta <= alpha) { note_cutoff(st, bd, moves[i], depth, 1); break; }
         }
+        if (policy_data && depth >= AI_POLICY_MIN_DEPTH && maxEval > alpha0) policy_record(bd, 1, bestMove);
+        tt_store(st, key, maxEval, depth, maxEval >= beta0 ? TT_LOWER : maxEval <= alpha0 ? TT_UPPER : TT_EXACT, bestMove);
         return maxEval;
     } else {
         int minEval = INT_MAX;
@@ -356,47 +1361,957 @@ int minimax(Board *bd, int depth, int alpha, int beta, int maximizingPlayer) {
         for (int i=0;i<n;i++) {
             copy_board(&tmp, bd);
             apply_move(&tmp, moves[i]);
-            int eval = minimax(&tmp, depth-1, alpha, beta, 1);
-            if (eval < minEval) minEval = eval;
+            st->mc_inherit = mc != NULL;
+            st->mc_move = moves[i];
+            st->mc_ply++;
+            int eval = minimax(st, &tmp, depth-1, alpha, beta, 1);
+            st->mc_ply--;
+            if (st->aborted) return 0;
+            if (eval < minEval) { minEval = eval; bestMove = moves[i]; }
             if (eval < beta) beta = eval;
-            if (beta <= alpha) break;
+            if (beta <= alpha) { note_cutoff(st, bd, moves[i], depth, 0); break; }
         }
+        if (policy_data && depth >= AI_POLICY_MIN_DEPTH && minEval < beta0) policy_record(bd, 0, bestMove);
+        tt_store(st, key, minEval, depth, minEval <= alpha0 ? TT_UPPER : minEval >= beta0 ? TT_LOWER : TT_EXACT, bestMove);
         return minEval;
     }
 }
 
-/* Escolhe a melhor jogada para o lado (white_turn) usando minimax */
-Move choose_ai_move(Board *bd, int white_turn) {
-    Move moves[MAX_MOVES];
-    int n = generate_legal_moves(bd, moves, white_turn);
-    Move best = {0,0,0,0,'\0'};
-    if (n == 0) return best;
-    int bestScore = white_turn ? INT_MIN : INT_MAX;
-    Board tmp;
-    for (int i=0;i<n;i++) {
-        copy_board(&tmp, bd);
-        apply_move(&tmp, moves[i]);
-        int score = minimax(&tmp, AI_DEPTH-1, INT_MIN/2, INT_MAX/2, !white_turn);
-        if (white_turn) {
-            if (score > bestScore) { bestScore = score; best = moves[i]; }
-        } else {
-            if (score < bestScore) { bestScore = score; best = moves[i]; }
+/* Cache de resultados da raiz, uma entrada por classe de simetria: guarda a jogada já
+   transformada para o canônico e só é aproveitada quando a busca original chegou a AI_DEPTH */
+#define RESULT_CACHE_SIZE 4096
+typedef struct {
+    unsigned long long key;
+    int depth;
+    Move move; /* no sistema de coordenadas do canônico */
+} ResultEntry;
+ResultEntry result_cache[RESULT_CACHE_SIZE];
+
+/* A chave não inclui o relógio dos 50 lances: só vale quando a busca não alcança o empate
+   (meios-lances + profundidade < 100), caso em que o relógio não muda o resultado */
+static inline int result_cache_usable(Board *bd) { return bd->halfmove + AI_DEPTH < 100; }
+
+/* Topologia NUMA lida de /sys; sem ela (ou com um só nó) nada é fixado */
+#define MAX_NUMA_NODES 16
+int numa_nodes = 0; /* 0 = ainda não detectada */
+cpu_set_t numa_cpus[MAX_NUMA_NODES];
+
+/* Lê uma lista de CPUs no formato do kernel ("0-3,8-11") */
+void parse_cpulist(const char *s, cpu_set_t *set) {
+    CPU_ZERO(set);
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10);
+        if (end == s) break;
+        long b = a;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (long c=a; c<=b && c<CPU_SETSIZE; c++) CPU_SET((int)c, set);
+        s = *end == ',' ? end + 1 : end;
+        if (*s == '\n') break;
+    }
+}
+
+void numa_detect(void) {
+    numa_nodes = 0;
+    for (int nd=0; nd<256 && numa_nodes<MAX_NUMA_NODES; nd++) {
+        char path[96], buf[1024];
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", nd);
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        if (fgets(buf, sizeof buf, fp)) {
+            parse_cpulist(buf, &numa_cpus[numa_nodes]);
+            if (CPU_COUNT(&numa_cpus[numa_nodes]) > 0) numa_nodes++;
         }
+        fclose(fp);
     }
-    return best;
+    if (numa_nodes == 0) numa_nodes = 1;
 }
 
-/* Converte coords para algébrico e imprime move */
-void print_move(Move m) {
-    char s[10];
-    s[0] = 'a' + m.f1;
-    s[1] = '0' + (8 - m.r1);
-    s[2] = '\0';
-    char t[10];
-    t[0] = 'a' + m.f2;
-    t[1] = '0' + (8 - m.r2);
-    t[2] = '\0';
-    if (m.promotion) printf("%s -> %s (promo %c)\n", s, t, m.promotion);
+/* Fixa a thread corrente nas CPUs do seu nó e aloca suas tabelas locais (first-touch) */
+void search_thread_enter(SearchThread *st) {
+    if (AI_NUMA && numa_nodes > 1 && st->pinned != st->node + 1) {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &numa_cpus[st->node]);
+        st->pinned = st->node + 1;
+    }
+    if (!st->local) {
+        st->local = malloc(sizeof(ThreadTables));
+        if (!st->local) { fprintf(stderr, "Sem memoria para tabelas da thread\n"); exit(1); }
+        memset(st->local, 0, sizeof(ThreadTables));
+    }
+}
+
+/* Threads de busca: a raiz é dividida entre elas. Cada jogada da raiz é buscada com janela
+   cheia, então seu score não depende da thread que o calculou. No modo determinístico a
+   divisão é fixa (jogada i -> thread i % n) e cada thread usa a própria fatia da tabela de
+   hash, limpa a cada busca; fora dele as threads pegam a próxima jogada livre e
+   compartilham a tabela inteira. */
+#define MAX_THREADS 64
+SearchThread search_threads[MAX_THREADS];
+
+/* Pool persistente de threads de busca. Os workers são criados uma vez e, entre tarefas,
+   giram por POOL_SPIN voltas conferindo o contador de tarefas e depois dormem numa condvar;
+   publicar uma tarefa custa um incremento atômico (mais um broadcast para quem dorme). */
+#define POOL_SPIN 20000
+
+typedef struct {
+    pthread_t tids[MAX_THREADS];
+    int size;                 /* workers criados (ids 1..size; o id 0 é a thread chamadora) */
+    unsigned start_seq[MAX_THREADS]; /* seq no momento da criação de cada worker */
+    atomic_uint seq;          /* incrementado a cada tarefa publicada */
+    atomic_int pending;       /* workers que ainda não terminaram a tarefa corrente */
+    void (*fn)(void *arg, int id);
+    void *arg;
+    int task_threads;         /* participantes da tarefa corrente, contando a chamadora */
+    int quit;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+} WorkerPool;
+
+WorkerPool pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER};
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+void *pool_worker(void *p) {
+    int id = (int)(long)p;
+    unsigned seen = pool.start_seq[id];
+    for (;;) {
+        unsigned s;
+        int spins = 0;
+        while ((s = atomic_load(&pool.seq)) == seen && spins < POOL_SPIN) { spins++; cpu_relax(); }
+        if (s == seen) {
+            pthread_mutex_lock(&pool.lock);
+            while ((s = atomic_load(&pool.seq)) == seen && !pool.quit) pthread_cond_wait(&pool.wake, &pool.lock);
+            pthread_mutex_unlock(&pool.lock);
+        }
+        if (pool.quit) return NULL;
+        seen = s;
+        if (id >= pool.task_threads) continue;
+        pool.fn(pool.arg, id);
+        if (atomic_fetch_sub(&pool.pending, 1) == 1) {
+            pthread_mutex_lock(&pool.lock);
+            pthread_cond_broadcast(&pool.done);
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+}
+
+/* Executa fn(arg, id) para id = 0..nthreads-1; o id 0 roda na thread chamadora */
+void pool_run(int nthreads, void (*fn)(void *arg, int id), void *arg) {
+    if (nthreads > MAX_THREADS) nthreads = MAX_THREADS;
+    if (nthreads <= 1) { fn(arg, 0); return; }
+    while (pool.size < nthreads - 1) {
+        pool.size++;
+        pool.start_seq[pool.size] = atomic_load(&pool.seq);
+        pthread_create(&pool.tids[pool.size], NULL, pool_worker, (void *)(long)pool.size);
+    }
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.task_threads = nthreads;
+    atomic_store(&pool.pending, nthreads - 1);
+    pthread_mutex_lock(&pool.lock);
+    atomic_fetch_add(&pool.seq, 1);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    fn(arg, 0);
+    int spins = 0;
+    while (atomic_load(&pool.pending) > 0 && spins < POOL_SPIN) { spins++; cpu_relax(); }
+    if (atomic_load(&pool.pending) > 0) {
+        pthread_mutex_lock(&pool.lock);
+        while (atomic_load(&pool.pending) > 0) pthread_cond_wait(&pool.done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+typedef struct {
+    Board *bd;
+    int white_turn;
+    Move *moves;
+    int n, depth;
+    int *scores;
+    int nthreads;
+    atomic_int next; /* próxima jogada livre (modo não determinístico) */
+    unsigned char *done;   /* jogadas já buscadas nesta profundidade (retomada de checkpoint) */
+    long long *move_nodes; /* nós gastos em cada jogada */
+} RootJob;
+
+/* Protege o progresso da raiz (scores, done e nós por jogada, e o resto de root_progress)
+   contra a leitura do checkpoint, que roda noutra thread durante a busca */
+pthread_mutex_t root_progress_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void search_root_slice(RootJob *job, SearchThread *st) {
+    Board tmp;
+    int i = AI_DETERMINISTIC ? st->id : atomic_fetch_add(&job->next, 1);
+    while (i < job->n && !st->aborted) {
+        if (!job->done[i]) {
+            long long before = st->nodes;
+            copy_board(&tmp, job->bd);
+            apply_move(&tmp, job->moves[i]);
+            int score = minimax(st, &tmp, job->depth-1, INT_MIN/2, INT_MAX/2, !job->white_turn);
+            if (!st->aborted) {
+                pthread_mutex_lock(&root_progress_lock);
+                job->scores[i] = score;
+                job->move_nodes[i] = st->nodes - before;
+                job->done[i] = 1;
+                pthread_mutex_unlock(&root_progress_lock);
+            }
+        }
+        i = AI_DETERMINISTIC ? i + job->nthreads : atomic_fetch_add(&job->next, 1);
+    }
+}
+
+void root_task(void *arg, int id) {
+    long long t0 = now_ns();
+    search_root_slice(arg, &search_threads[id]);
+    search_threads[id].busy_ns += now_ns() - t0;
+}
+
+/* Preparação de cada thread no início da busca: fixa no nó NUMA, aloca as tabelas locais e,
+   se pedido, zera a sua parte do hash (first-touch). A limpeza completa é dividida entre as
+   threads do pool em vez de um memset de gigabytes numa thread só. */
+typedef struct {
+    int nthreads;
+    int clear_tt;
+    int reset_local;
+} SearchStart;
+
+void search_start_task(void *arg, int id) {
+    SearchStart *ss = arg;
+    SearchThread *st = &search_threads[id];
+    search_thread_enter(st);
+    if (ss->reset_local) memset(st->local, 0, sizeof(ThreadTables));
+    if (ss->clear_tt) {
+        unsigned long long a = tt_entries * id / ss->nthreads, b = tt_entries * (id + 1) / ss->nthreads;
+        memset(tt_table + a, 0, (b - a) * sizeof(TTEntry));
+    }
+}
+
+/* Limpeza explícita e completa da tabela, em paralelo pelas threads de busca */
+void tt_clear(void) {
+    if (!numa_nodes) numa_detect();
+    int nthreads = AI_THREADS < 1 ? 1 : AI_THREADS > MAX_THREADS ? MAX_THREADS : AI_THREADS;
+    for (int t=0;t<nthreads;t++) { search_threads[t].id = t; search_threads[t].node = t % numa_nodes; }
+    SearchStart ss = {nthreads, 1, 0};
+    pool_run(nthreads, search_start_task, &ss);
+    tt_needs_touch = 0;
+}
+
+/* Busca uma iteração completa na raiz, pulando as jogadas marcadas em done (que recebem as
+   demais conforme terminam); retorna 0 se alguma thread foi abortada por limite */
+int search_root(Board *bd, int white_turn, Move *moves, int n, int depth, int *scores, int nthreads,
+                unsigned char *done, long long *move_nodes) {
+    RootJob job = {.bd = bd, .white_turn = white_turn, .moves = moves, .n = n, .depth = depth,
+                   .scores = scores, .nthreads = nthreads, .done = done, .move_nodes = move_nodes};
+    atomic_init(&job.next, 0);
+    pool_run(nthreads, root_task, &job); /* a thread chamadora é a thread 0 */
+    for (int t=0;t<nthreads;t++) if (search_threads[t].aborted) return 0;
+    return 1;
+}
+
+/* Controlador de carga: estima a latência de um pedido novo como a latência média recente
+   vezes (fila + 1) e, comparando com AI_SLO_MS, encolhe ou devolve aos poucos o orçamento das
+   próximas buscas. A fila é informada por quem hospeda o motor; a latência, pela própria
+   choose_ai_move. */
+typedef struct {
+    pthread_mutex_t lock;
+    double scale;        /* fração do orçamento configurado, em [AI_LOAD_MIN_SCALE, 1] */
+    double latency_ewma; /* ms */
+    int queue_depth;     /* pedidos aguardando busca */
+} LoadController;
+
+LoadController load = {PTHREAD_MUTEX_INITIALIZER, 1.0, 0.0, 0};
+
+void load_report_queue(int depth) {
+    pthread_mutex_lock(&load.lock);
+    load.queue_depth = depth;
+    pthread_mutex_unlock(&load.lock);
+}
+
+void load_report_latency(double ms) {
+    pthread_mutex_lock(&load.lock);
+    load.latency_ewma = load.latency_ewma == 0 ? ms : 0.8 * load.latency_ewma + 0.2 * ms;
+    if (AI_SLO_MS > 0) {
+        double projected = load.latency_ewma * (load.queue_depth + 1);
+        double ratio = projected > 0 ? AI_SLO_MS / projected : 2.0;
+        if (ratio < 0.5) ratio = 0.5;   /* no máximo corta pela metade... */
+        if (ratio > 1.25) ratio = 1.25; /* ...e recupera devagar */
+        double target = load.scale * ratio;
+        load.scale = 0.7 * load.scale + 0.3 * target;
+        if (load.scale < AI_LOAD_MIN_SCALE) load.scale = AI_LOAD_MIN_SCALE;
+        if (load.scale > 1.0) load.scale = 1.0;
+    }
+    pthread_mutex_unlock(&load.lock);
+}
+
+double load_budget_scale(void) {
+    if (AI_SLO_MS <= 0 || AI_DETERMINISTIC) return 1.0;
+    pthread_mutex_lock(&load.lock);
+    double sc = load.scale;
+    pthread_mutex_unlock(&load.lock);
+    return sc;
+}
+
+/* Níveis de habilidade: em vez de cortar profundidade, cada nível abaixo do máximo ganha um
+   orçamento de nós (dobra a cada dois níveis) e sorteia entre as jogadas da raiz que ficaram
+   a até skill_margin centipeões da melhor. Os níveis baixos custam uma fração mínima de CPU. */
+#define SKILL_MAX 20
+
+long long skill_nodes(int level) {
+    return 50LL << (level / 2);
+}
+
+int skill_margin(int level) {
+    return (SKILL_MAX - level) * 20;
+}
+
+/* Sorteia uma jogada entre as próximas da melhor; no modo determinístico a semente vem da posição */
+int skill_pick(int *scores, int n, int white_turn, int best, unsigned long long seed) {
+    int cand[MAX_MOVES], nc = 0;
+    int margin = skill_margin(AI_SKILL);
+    for (int i=0;i<n;i++) {
+        long long diff = white_turn ? (long long)scores[best] - scores[i] : (long long)scores[i] - scores[best];
+        if (diff <= margin) cand[nc++] = i;
+    }
+    if (AI_DETERMINISTIC) return cand[splitmix64(&seed) % nc];
+    return cand[rand() % nc];
+}
+
+/* Índice da melhor jogada da raiz (primeira em caso de empate) e score da segunda melhor */
+int pick_root_best(int *scores, int n, int white_turn, int *second) {
+    int best = 0;
+    for (int i=1;i<n;i++) {
+        if (white_turn ? scores[i] > scores[best] : scores[i] < scores[best]) best = i;
+    }
+    *second = white_turn ? INT_MIN : INT_MAX;
+    for (int i=0;i<n;i++) {
+        if (i == best) continue;
+        if (white_turn ? scores[i] > *second : scores[i] < *second) *second = scores[i];
+    }
+    return best;
+}
+
+/* Escolhe a melhor jogada para o lado (white_turn) usando aprofundamento iterativo.
+   O controle de tempo responde na hora quando só há uma jogada legal ou quando uma captura
+   domina as alternativas já na profundidade 2; encerra cedo quando a melhor jogada se mantém
+   estável por AI_STABLE_ITERS iterações (a partir de AI_STABLE_MIN_DEPTH, ou da penúltima
+   profundidade quando AI_DEPTH é menor, para que a parada ainda poupe a última iteração) e só
+   passa de AI_TIME_MS se o score estiver caindo.
+   Preenche info com a jogada, o score, a profundidade completada, os nós e o tempo. */
+typedef struct {
+    Move best;
+    int score;       /* orientado para as brancas */
+    int depth;       /* profundidade completada (0 = respondida sem busca) */
+    long long nodes;
+    long long time_ms;
+    int stable_stop;           /* encerrada antes de AI_DEPTH pela parada por estabilidade */
+    int iters;                 /* iterações completadas (a i-ésima buscou profundidade i + 1) */
+    Move iter_best[MAX_PLY];
+    int iter_score[MAX_PLY];
+    long long iter_ms[MAX_PLY]; /* desde o início da busca */
+} SearchInfo;
+
+SearchInfo last_search; /* resultado da última choose_ai_move */
+
+/* Métricas do processo, no formato de texto do Prometheus: contadores acumulados desde o
+   início, histograma de latência por busca e quantis das últimas METRICS_WINDOW buscas.
+   Cada busca soma os contadores das threads uma vez ao terminar; o caminho quente só mexe
+   em campos da própria SearchThread. */
+#define METRICS_BUCKETS 13
+const double metrics_bounds_ms[METRICS_BUCKETS] = {1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+#define METRICS_WINDOW 1024
+
+typedef struct {
+    pthread_mutex_t lock;
+    long long searches;
+    long long cache_hits;    /* respondidas pelo cache de resultados ou por jogada forçada */
+    long long stable_stops;  /* encerradas cedo pela estabilidade da melhor jogada */
+    long long nodes;
+    long long tt_probes, tt_hits;
+    long long busy_ns;       /* tempo das threads dentro de search_root */
+    long long capacity_ns;   /* duração das buscas vezes threads usadas */
+    double latency_sum_ms;
+    long long buckets[METRICS_BUCKETS + 1]; /* último = +Inf */
+    double recent[METRICS_WINDOW];
+    int recent_n, recent_pos;
+    double last_nps;
+} Metrics;
+
+Metrics metrics = {.lock = PTHREAD_MUTEX_INITIALIZER};
+const char *metrics_file = NULL; /* --metrics-file: reescrito a cada metrics_interval_ms */
+int metrics_interval_ms = 5000;
+int metrics_port = 0;            /* --metrics-port: HTTP em 127.0.0.1 */
+
+void metrics_record(const SearchInfo *info, int nthreads, long long wall_ns) {
+    pthread_mutex_lock(&metrics.lock);
+    metrics.searches++;
+    if (nthreads == 0) metrics.cache_hits++;
+    metrics.stable_stops += info->stable_stop;
+    metrics.nodes += info->nodes;
+    for (int t=0;t<nthreads;t++) {
+        metrics.tt_probes += search_threads[t].tt_probes;
+        metrics.tt_hits += search_threads[t].tt_hits;
+        metrics.busy_ns += search_threads[t].busy_ns;
+    }
+    metrics.capacity_ns += wall_ns * nthreads;
+    double ms = (double)info->time_ms;
+    metrics.latency_sum_ms += ms;
+    int b = 0;
+    while (b < METRICS_BUCKETS && ms > metrics_bounds_ms[b]) b++;
+    metrics.buckets[b]++;
+    metrics.recent[metrics.recent_pos] = ms;
+    metrics.recent_pos = (metrics.recent_pos + 1) % METRICS_WINDOW;
+    if (metrics.recent_n < METRICS_WINDOW) metrics.recent_n++;
+    if (wall_ns > 0) metrics.last_nps = info->nodes * 1e9 / wall_ns;
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Fração do hash ocupada pela geração atual, estimada numa amostra do início da tabela */
+double tt_fill_estimate(void) {
+    if (!tt_table || tt_entries == 0) return 0.0;
+    unsigned long long sample = tt_entries < 4096 ? tt_entries : 4096, used = 0;
+    for (unsigned long long i=0;i<sample;i++) {
+        unsigned long long data = tt_table[i].data;
+        if (data && (int)(data >> 57) == tt_generation) used++;
+    }
+    return (double)used / sample;
+}
+
+/* Escreve o texto de exposição em out; retorna o tamanho */
+size_t metrics_render(char *out, size_t cap) {
+    static double sorted[METRICS_WINDOW];
+    size_t len = 0;
+#define METRICS_PUT(...) do { int w_ = snprintf(out + len, cap - len, __VA_ARGS__); \
+        if (w_ > 0) len = len + (size_t)w_ < cap ? len + (size_t)w_ : cap - 1; } while (0)
+    pthread_mutex_lock(&metrics.lock);
+    Metrics m = metrics;
+    pthread_mutex_unlock(&metrics.lock);
+    METRICS_PUT("# HELP chess_searches_total Buscas atendidas.\n# TYPE chess_searches_total counter\n");
+    METRICS_PUT("chess_searches_total %lld\n", m.searches);
+    METRICS_PUT("# HELP chess_searches_cached_total Buscas respondidas sem busca (cache ou jogada forcada).\n# TYPE chess_searches_cached_total counter\n");
+    METRICS_PUT("chess_searches_cached_total %lld\n", m.cache_hits);
+    METRICS_PUT("# HELP chess_searches_stable_stop_total Buscas encerradas antes da profundidade maxima pela estabilidade.\n# TYPE chess_searches_stable_stop_total counter\n");
+    METRICS_PUT("chess_searches_stable_stop_total %lld\n", m.stable_stops);
+    METRICS_PUT("# HELP chess_nodes_total Nos visitados.\n# TYPE chess_nodes_total counter\n");
+    METRICS_PUT("chess_nodes_total %lld\n", m.nodes);
+    METRICS_PUT("# HELP chess_nodes_per_second Nos por segundo da ultima busca.\n# TYPE chess_nodes_per_second gauge\n");
+    METRICS_PUT("chess_nodes_per_second %.0f\n", m.last_nps);
+    METRICS_PUT("# HELP chess_search_latency_ms Latencia por busca.\n# TYPE chess_search_latency_ms histogram\n");
+    long long acc = 0;
+    for (int b=0;b<METRICS_BUCKETS;b++) {
+        acc += m.buckets[b];
+        METRICS_PUT("chess_search_latency_ms_bucket{le=\"%g\"} %lld\n", metrics_bounds_ms[b], acc);
+    }
+    acc += m.buckets[METRICS_BUCKETS];
+    METRICS_PUT("chess_search_latency_ms_bucket{le=\"+Inf\"} %lld\n", acc);
+    METRICS_PUT("chess_search_latency_ms_sum %.0f\nchess_search_latency_ms_count %lld\n", m.latency_sum_ms, acc);
+    METRICS_PUT("# HELP chess_search_latency_recent_ms Quantis das ultimas %d buscas.\n# TYPE chess_search_latency_recent_ms summary\n", METRICS_WINDOW);
+    memcpy(sorted, m.recent, m.recent_n * sizeof(double));
+    qsort(sorted, m.recent_n, sizeof(double), cmp_double);
+    const double qs[] = {0.5, 0.9, 0.99};
+    double rsum = 0;
+    for (int i=0;i<m.recent_n;i++) rsum += sorted[i];
+    for (int q=0;q<3;q++) {
+        double v = m.recent_n ? sorted[(int)(qs[q] * (m.recent_n - 1))] : 0;
+        METRICS_PUT("chess_search_latency_recent_ms{quantile=\"%g\"} %.0f\n", qs[q], v);
+    }
+    METRICS_PUT("chess_search_latency_recent_ms_sum %.0f\nchess_search_latency_recent_ms_count %d\n", rsum, m.recent_n);
+    METRICS_PUT("# HELP chess_hash_probes_total Consultas ao hash.\n# TYPE chess_hash_probes_total counter\n");
+    METRICS_PUT("chess_hash_probes_total %lld\n", m.tt_probes);
+    METRICS_PUT("# HELP chess_hash_hits_total Consultas ao hash que acharam a posicao.\n# TYPE chess_hash_hits_total counter\n");
+    METRICS_PUT("chess_hash_hits_total %lld\n", m.tt_hits);
+    METRICS_PUT("# HELP chess_hash_hit_ratio Acertos sobre consultas desde o inicio.\n# TYPE chess_hash_hit_ratio gauge\n");
+    METRICS_PUT("chess_hash_hit_ratio %.4f\n", m.tt_probes ? (double)m.tt_hits / m.tt_probes : 0.0);
+    METRICS_PUT("# HELP chess_hash_fill_ratio Ocupacao do hash pela geracao atual (amostra).\n# TYPE chess_hash_fill_ratio gauge\n");
+    METRICS_PUT("chess_hash_fill_ratio %.4f\n", tt_fill_estimate());
+    METRICS_PUT("# HELP chess_hash_bytes Tamanho do hash.\n# TYPE chess_hash_bytes gauge\n");
+    METRICS_PUT("chess_hash_bytes %llu\n", tt_entries * (unsigned long long)sizeof(TTEntry));
+    METRICS_PUT("# HELP chess_thread_utilization Fracao do tempo de busca em que as threads trabalharam.\n# TYPE chess_thread_utilization gauge\n");
+    METRICS_PUT("chess_thread_utilization %.4f\n", m.capacity_ns ? (double)m.busy_ns / m.capacity_ns : 0.0);
+    METRICS_PUT("# HELP chess_search_threads Threads de busca configuradas.\n# TYPE chess_search_threads gauge\n");
+    METRICS_PUT("chess_search_threads %d\n", AI_THREADS);
+#undef METRICS_PUT
+    return len;
+}
+
+/* Grava em arquivo temporário e renomeia, para quem lê nunca ver um arquivo pela metade */
+void metrics_write_file(char *buf, size_t cap) {
+    char tmp[4096];
+    snprintf(tmp, sizeof tmp, "%s.tmp", metrics_file);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    size_t len = metrics_render(buf, cap);
+    fwrite(buf, 1, len, f);
+    if (fclose(f) == 0) rename(tmp, metrics_file);
+}
+
+/* Thread exportadora: atende GET em metrics_port e regrava metrics_file no intervalo */
+void *metrics_main(void *arg) {
+    (void)arg;
+    static char buf[32768];
+    int lfd = -1;
+    if (metrics_port > 0) {
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((unsigned short)metrics_port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int one = 1;
+        lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (lfd >= 0) setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (lfd < 0 || bind(lfd, (struct sockaddr *)&sa, sizeof sa) < 0 || listen(lfd, 16) < 0) {
+            fprintf(stderr, "Metricas: porta %d indisponivel\n", metrics_port);
+            if (lfd >= 0) close(lfd);
+            lfd = -1;
+        }
+    }
+    long long next_write = now_ms();
+    for (;;) {
+        if (metrics_file && now_ms() >= next_write) {
+            metrics_write_file(buf, sizeof buf);
+            next_write = now_ms() + (metrics_interval_ms > 0 ? metrics_interval_ms : 5000);
+        }
+        long long wait = metrics_file ? next_write - now_ms() : -1;
+        if (lfd < 0) {
+            if (!metrics_file) return NULL;
+            struct timespec ts = {wait / 1000, (wait % 1000) * 1000000L};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+        struct pollfd pfd = {lfd, POLLIN, 0};
+        if (poll(&pfd, 1, wait < 0 ? -1 : (int)wait) <= 0) continue;
+        int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        struct timeval tv = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+        char req[1024];
+        (void)recv(fd, req, sizeof req, 0); /* qualquer pedido recebe as métricas */
+        size_t len = metrics_render(buf, sizeof buf);
+        char head[128];
+        int hl = snprintf(head, sizeof head, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", len);
+        if (send(fd, head, hl, MSG_NOSIGNAL) == hl) (void)send(fd, buf, len, MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+void metrics_start(void) {
+    if (!metrics_file && metrics_port <= 0) return;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, metrics_main, NULL) == 0) pthread_detach(tid);
+}
+
+
+/* Gravador de voo: anel com as últimas FLIGHT_RECORDS buscas (posição, limites, resultado e o
+   instante em que cada iteração terminou). A busca em andamento ocupa o seu registro desde o
+   início, então um despejo durante um "travamento" mostra a posição e até onde ela chegou.
+   Despejado pelo comando 'flight' ou pelo sinal SIGUSR1 (em stderr). */
+#define FLIGHT_RECORDS 64
+#define FLIGHT_ITERS 32
+
+typedef struct {
+    long long serial;      /* 0 = registro vazio */
+    time_t wall;           /* início, relógio de parede */
+    long long start_ms;
+    Board bd;
+    int white_turn;
+    unsigned long long key;
+    int depth_limit, threads;
+    long long time_limit, node_limit;
+    double scale;
+    int running;
+    int depth;             /* profundidade completada */
+    long long nodes, time_ms;
+    Move best;
+    int score;
+    int iters;
+    int iter_ms[FLIGHT_ITERS];        /* tempo desde o início ao fim de cada iteração */
+    long long iter_nodes[FLIGHT_ITERS];
+} FlightRecord;
+
+struct {
+    pthread_mutex_t lock;
+    FlightRecord rec[FLIGHT_RECORDS];
+    long long serial;
+} flight = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+FlightRecord *flight_begin(Board *bd, int white_turn, unsigned long long key, long long time_limit,
+                           long long node_limit, double scale, int threads) {
+    pthread_mutex_lock(&flight.lock);
+    long long serial = ++flight.serial;
+    FlightRecord *fr = &flight.rec[serial % FLIGHT_RECORDS];
+    memset(fr, 0, sizeof *fr);
+    fr->serial = serial;
+    fr->wall = time(NULL);
+    fr->start_ms = now_ms();
+    copy_board(&fr->bd, bd);
+    fr->white_turn = white_turn;
+    fr->key = key;
+    fr->depth_limit = AI_DEPTH;
+    fr->time_limit = time_limit;
+    fr->node_limit = node_limit;
+    fr->scale = scale;
+    fr->threads = threads;
+    fr->running = 1;
+    pthread_mutex_unlock(&flight.lock);
+    return fr;
+}
+
+void flight_iteration(FlightRecord *fr, int depth, long long nodes, Move best, int score) {
+    pthread_mutex_lock(&flight.lock);
+    if (fr->iters < FLIGHT_ITERS) {
+        fr->iter_ms[fr->iters] = (int)(now_ms() - fr->start_ms);
+        fr->iter_nodes[fr->iters] = nodes;
+        fr->iters++;
+    }
+    fr->depth = depth;
+    fr->nodes = nodes;
+    fr->best = best;
+    fr->score = score;
+    pthread_mutex_unlock(&flight.lock);
+}
+
+void flight_end(FlightRecord *fr, const SearchInfo *info) {
+    pthread_mutex_lock(&flight.lock);
+    fr->running = 0;
+    fr->depth = info->depth;
+    fr->nodes = info->nodes;
+    fr->time_ms = info->time_ms;
+    fr->best = info->best;
+    fr->score = info->score;
+    pthread_mutex_unlock(&flight.lock);
+}
+
+/* Progresso da raiz da busca em andamento, lido pelo checkpoint da análise: scores e nós da
+   iteração corrente (done marca as jogadas já buscadas) e o resultado da última completa */
+typedef struct {
+    Board bd;
+    int white_turn;
+    int n;
+    Move moves[MAX_MOVES];
+    int depth;                      /* iteração em andamento */
+    int scores[MAX_MOVES];
+    unsigned char done[MAX_MOVES];
+    long long move_nodes[MAX_MOVES];
+    int reached;                    /* última iteração completa */
+    int prev_scores[MAX_MOVES];
+    Move best;
+    int best_score;
+} RootProgress;
+
+RootProgress root_progress;
+RootProgress *search_resume = NULL;  /* progresso salvo, retomado pela próxima busca da mesma posição */
+ThreadTables *resume_tables = NULL;  /* killers e histórico salvos com ele */
+void (*iteration_hook)(void) = NULL; /* chamada ao fim de cada iteração completa */
+int search_full = 0;                 /* modos de análise: busca também a jogada única e ignora o cache de resultados */
+
+/* Retoma o progresso salvo se for da mesma posição (mesmas jogadas, na mesma ordem);
+   retorna a profundidade por onde recomeçar, ou 0 se não serve */
+int search_resume_apply(RootProgress *ck, int *done_scores, Move *best, int *best_score, int *reached) {
+    RootProgress *rp = &root_progress;
+    if (ck->white_turn != rp->white_turn || ck->n != rp->n || memcmp(&ck->bd, &rp->bd, sizeof(Board))) return 0;
+    for (int i=0;i<rp->n;i++) if (!moves_equal(ck->moves[i], rp->moves[i])) return 0;
+    *reached = rp->reached = ck->reached;
+    *best = rp->best = ck->best;
+    *best_score = rp->best_score = ck->best_score;
+    memcpy(done_scores, ck->prev_scores, rp->n * sizeof(int));
+    memcpy(rp->prev_scores, ck->prev_scores, rp->n * sizeof(int));
+    if (ck->depth <= ck->reached) { memset(rp->done, 0, rp->n); return ck->reached + 1; }
+    memcpy(rp->scores, ck->scores, rp->n * sizeof(int));
+    memcpy(rp->done, ck->done, rp->n);
+    memcpy(rp->move_nodes, ck->move_nodes, rp->n * sizeof(long long));
+    return ck->depth; /* iteração pela metade: só faltam as jogadas sem done */
+}
+
+Move search_position(Board *bd, int white_turn, SearchInfo *info) {
+    Move moves[MAX_MOVES];
+    int done_scores[MAX_MOVES];
+    int n = generate_legal_moves(bd, moves, white_turn);
+    Move best = {0,0,0,0,'\0'};
+    memset(info, 0, sizeof *info);
+    if (n == 0) return best;
+    best = moves[0];
+    info->best = best;
+    if (n == 1 && !search_full) { metrics_record(info, 0, 0); return best; } /* resposta forçada */
+
+    /* o cache depende do histórico de buscas: fora do modo determinístico e dos níveis sorteados */
+    int weakened = AI_SKILL < SKILL_MAX;
+    int sym;
+    unsigned long long key = canonical_hash(bd, white_turn, &sym);
+    ResultEntry *re = &result_cache[key % RESULT_CACHE_SIZE];
+    if (!AI_DETERMINISTIC && !weakened && !search_full && result_cache_usable(bd) && re->key == key && re->depth >= AI_DEPTH) {
+        info->best = transform_move(re->move, sym);
+        info->depth = re->depth;
+        metrics_record(info, 0, 0);
+        return info->best;
+    }
+
+    long long start = now_ms(), start_ns = now_ns();
+    /* orçamento desta busca, reduzido pelo controlador de carga */
+    double scale = load_budget_scale();
+    long long time_ms = AI_TIME_MS > 0 ? AI_TIME_MS : (scale < 1.0 ? AI_SLO_MS : 0);
+    long long node_budget = AI_NODES;
+    if (scale < 1.0) {
+        time_ms = (long long)(time_ms * scale) > 0 ? (long long)(time_ms * scale) : 1;
+        if (node_budget > 0) node_budget = (long long)(node_budget * scale) > 0 ? (long long)(node_budget * scale) : 1;
+    }
+    if (weakened && (node_budget == 0 || skill_nodes(AI_SKILL) < node_budget)) node_budget = skill_nodes(AI_SKILL);
+    int floor_depth = scale < 1.0 ? AI_LOAD_MIN_DEPTH : 0; /* iterações até aqui não têm limite */
+    if (weakened && floor_depth < 1) floor_depth = 1; /* o sorteio precisa de scores de todas as jogadas */
+    int nthreads = AI_THREADS < 1 ? 1 : AI_THREADS > MAX_THREADS ? MAX_THREADS : AI_THREADS;
+    if (!tt_table) tt_resize(AI_HASH_MB);
+    if (!numa_nodes) numa_detect();
+    unsigned long long slice = tt_entries;
+    if (AI_DETERMINISTIC) {
+        while (slice > 1 && slice * nthreads > tt_entries) slice /= 2;
+    }
+    /* modo determinístico: nova geração (hash vazio em O(1)) e tabelas locais zeradas;
+       após realocação ou volta do contador, as threads zeram o hash antes de buscar */
+    if (AI_DETERMINISTIC) tt_new_generation();
+    SearchStart ss = {nthreads, tt_needs_touch, AI_DETERMINISTIC};
+    tt_needs_touch = 0;
+    for (int t=0;t<nthreads;t++) {
+        SearchThread *st = &search_threads[t];
+        st->id = t;
+        st->node = t % numa_nodes;
+        st->nodes = 0;
+        st->tt_probes = st->tt_hits = st->tt_stores = st->tt_evictions = st->busy_ns = 0;
+        st->aborted = 0;
+        st->node_limit = node_budget > 0 ? (node_budget / nthreads > 0 ? node_budget / nthreads : 1) : 0;
+        st->tt = AI_DETERMINISTIC ? tt_table + t * slice : tt_table;
+        st->tt_mask = slice - 1;
+    }
+    pool_run(nthreads, search_start_task, &ss);
+    FlightRecord *fr = flight_begin(bd, white_turn, key, time_ms, node_budget, scale, nthreads);
+    RootProgress *rp = &root_progress;
+    int *scores = rp->scores;
+    int bestScore = 0, stable = 0, reached = 0;
+    int stable_min = AI_STABLE_MIN_DEPTH < AI_DEPTH - 1 ? AI_STABLE_MIN_DEPTH : AI_DEPTH - 1;
+    pthread_mutex_lock(&root_progress_lock);
+    copy_board(&rp->bd, bd);
+    rp->white_turn = white_turn;
+    rp->n = n;
+    memcpy(rp->moves, moves, n * sizeof(Move));
+    rp->depth = rp->reached = 0;
+    int first_depth = search_resume ? search_resume_apply(search_resume, done_scores, &best, &bestScore, &reached) : 0;
+    pthread_mutex_unlock(&root_progress_lock);
+    if (first_depth && resume_tables) {
+        for (int t=0;t<nthreads;t++) memcpy(search_threads[t].local, resume_tables, sizeof(ThreadTables));
+    }
+    search_resume = NULL;
+    for (int depth = first_depth ? first_depth : 1; depth <= AI_DEPTH; depth++) {
+        for (int t=0;t<nthreads;t++) {
+            SearchThread *st = &search_threads[t];
+            st->deadline = !AI_DETERMINISTIC && time_ms > 0 && depth > floor_depth ? start + 2 * time_ms : 0;
+            if (depth <= floor_depth) st->node_limit = 0;
+            else if (node_budget > 0) st->node_limit = node_budget / nthreads > 0 ? node_budget / nthreads : 1;
+        }
+        pthread_mutex_lock(&root_progress_lock);
+        if (depth != first_depth) memset(rp->done, 0, n);
+        rp->depth = depth;
+        pthread_mutex_unlock(&root_progress_lock);
+        if (!search_root(bd, white_turn, moves, n, depth, scores, nthreads, rp->done, rp->move_nodes)) break; /* mantém a iteração anterior */
+        int second;
+        int bi = pick_root_best(scores, n, white_turn, &second);
+        int drop = white_turn ? bestScore - scores[bi] : scores[bi] - bestScore;
+        if (depth > 1 && moves_equal(moves[bi], best) && abs(scores[bi] - bestScore) <= AI_STABLE_MARGIN) stable++;
+        else stable = 1;
+        best = moves[bi];
+        bestScore = scores[bi];
+        reached = depth;
+        memcpy(done_scores, scores, n * sizeof(int));
+        long long nodes = 0;
+        for (int t=0;t<nthreads;t++) nodes += search_threads[t].nodes;
+        flight_iteration(fr, depth, nodes, best, bestScore);
+        if (info->iters < MAX_PLY) {
+            info->iter_best[info->iters] = best;
+            info->iter_score[info->iters] = bestScore;
+            info->iter_ms[info->iters] = now_ms() - start;
+            info->iters++;
+        }
+        pthread_mutex_lock(&root_progress_lock);
+        rp->reached = depth;
+        rp->best = best;
+        rp->best_score = bestScore;
+        memcpy(rp->prev_scores, scores, n * sizeof(int));
+        pthread_mutex_unlock(&root_progress_lock);
+        if (iteration_hook) iteration_hook();
+        if (depth == AI_DEPTH) break;
+        /* captura que supera todas as alternativas por larga margem: recaptura óbvia */
+        long long margin = white_turn ? (long long)bestScore - second : (long long)second - bestScore;
+        if (depth == 2 && bd->cell[best.r2][best.f2] != '.' && margin >= AI_RECAPTURE_MARGIN) break;
+        if (stable >= AI_STABLE_ITERS && depth >= stable_min) { info->stable_stop = 1; break; }
+        /* estourou o orçamento: só estende (até o limite rígido) se o score caiu */
+        if (!AI_DETERMINISTIC && time_ms > 0 && now_ms() - start >= time_ms && !(depth > 1 && drop > AI_STABLE_MARGIN)) break;
+    }
+    info->time_ms = now_ms() - start;
+    for (int t=0;t<nthreads;t++) info->nodes += search_threads[t].nodes;
+    info->depth = reached;
+    info->score = bestScore;
+    if (!AI_DETERMINISTIC) load_report_latency((double)info->time_ms);
+    metrics_record(info, nthreads, now_ns() - start_ns);
+    info->best = best;
+    if (weakened && reached > 0) {
+        int second;
+        int bi = pick_root_best(done_scores, n, white_turn, &second);
+        int pick = skill_pick(done_scores, n, white_turn, bi, key);
+        info->score = done_scores[pick];
+        info->best = moves[pick];
+        flight_end(fr, info); /* registra a jogada efetivamente escolhida pelo nível */
+        return info->best;
+    }
+    if (reached == AI_DEPTH && !AI_DETERMINISTIC && result_cache_usable(bd)) {
+        re->key = key;
+        re->depth = reached;
+        re->move = transform_move(best, sym);
+    }
+    flight_end(fr, info);
+    return best;
+}
+
+/* Prepara a thread 0 para uma busca avulsa (fora de search_position), sem limites */
+SearchThread *prepare_single_search(void) {
+    if (!tt_table) tt_resize(AI_HASH_MB);
+    if (!numa_nodes) numa_detect();
+    SearchThread *st = &search_threads[0];
+    st->id = 0;
+    st->node = 0;
+    st->nodes = 0;
+    st->tt_probes = st->tt_hits = st->tt_stores = st->tt_evictions = st->busy_ns = 0;
+    st->aborted = 0;
+    st->node_limit = 0;
+    st->deadline = 0;
+    st->tt = tt_table;
+    st->tt_mask = tt_entries - 1;
+    SearchStart ss = {1, tt_needs_touch, 0};
+    tt_needs_touch = 0;
+    search_start_task(&ss, 0);
+    return st;
+}
+
+/* Uma passada de janela nula (beta-1, beta) na raiz; retorna o valor fail-soft e, em best,
+   a jogada que o produziu (a que provou o limite, se houve corte) */
+int mtdf_root(SearchThread *st, Board *bd, int white_turn, Move *moves, int n, int depth, int beta, Move *best) {
+    int value = white_turn ? INT_MIN : INT_MAX;
+    Board tmp;
+    *best = moves[0];
+    for (int i=0;i<n;i++) {
+        copy_board(&tmp, bd);
+        apply_move(&tmp, moves[i]);
+        int v = minimax(st, &tmp, depth-1, beta-1, beta, !white_turn);
+        if (st->aborted) return 0;
+        if (white_turn ? v > value : v < value) { value = v; *best = moves[i]; }
+        if (white_turn ? value >= beta : value < beta) break;
+    }
+    return value;
+}
+
+/* Driver MTD(f): em cada profundidade, converge ao valor minimax com buscas de janela nula,
+   partindo do valor da iteração anterior e apoiado no hash. A jogada é a que provou o limite
+   final (limite inferior para as brancas, superior para as pretas). Roda só na thread 0;
+   respeita AI_NODES e AI_TIME_MS (reduzidos pelo controlador de carga), o cache de resultados
+   e o gravador de voo, mas não as paradas por estabilidade. Não dá scores por jogada, então
+   os níveis abaixo do máximo ficam com search_position (ver choose_ai_move). */
+Move search_mtdf(Board *bd, int white_turn, SearchInfo *info) {
+    Move moves[MAX_MOVES];
+    int n = generate_legal_moves(bd, moves, white_turn);
+    Move best = {0,0,0,0,'\0'};
+    memset(info, 0, sizeof *info);
+    if (n == 0) return best;
+    best = moves[0];
+    info->best = best;
+    if (n == 1) { metrics_record(info, 0, 0); return best; }
+
+    int sym;
+    unsigned long long key = canonical_hash(bd, white_turn, &sym);
+    ResultEntry *re = &result_cache[key % RESULT_CACHE_SIZE];
+    if (!AI_DETERMINISTIC && result_cache_usable(bd) && re->key == key && re->depth >= AI_DEPTH) {
+        info->best = transform_move(re->move, sym);
+        info->depth = re->depth;
+        metrics_record(info, 0, 0);
+        return info->best;
+    }
+
+    long long start = now_ms(), start_ns = now_ns();
+    double scale = load_budget_scale();
+    long long time_ms = AI_TIME_MS > 0 ? AI_TIME_MS : (scale < 1.0 ? AI_SLO_MS : 0);
+    long long node_budget = AI_NODES;
+    if (scale < 1.0) {
+        time_ms = (long long)(time_ms * scale) > 0 ? (long long)(time_ms * scale) : 1;
+        if (node_budget > 0) node_budget = (long long)(node_budget * scale) > 0 ? (long long)(node_budget * scale) : 1;
+    }
+    int floor_depth = scale < 1.0 ? AI_LOAD_MIN_DEPTH : 0;
+    SearchThread *st = prepare_single_search();
+    FlightRecord *fr = flight_begin(bd, white_turn, key, time_ms, node_budget, scale, 1);
+    int g = 0, score = 0, reached = 0;
+    for (int depth = 1; depth <= AI_DEPTH; depth++) {
+        /* limites valem sobre o total de nós da busca, não por iteração */
+        st->deadline = !AI_DETERMINISTIC && time_ms > 0 && depth > floor_depth ? start + 2 * time_ms : 0;
+        st->node_limit = depth > floor_depth ? node_budget : 0;
+        int lower = INT_MIN/2, upper = INT_MAX/2;
+        Move it_best = best;
+        order_moves(st, bd, moves, n, depth, white_turn, &best);
+        while (lower < upper) {
+            int beta = g == lower ? g + 1 : g;
+            Move m;
+            g = mtdf_root(st, bd, white_turn, moves, n, depth, beta, &m);
+            if (st->aborted) break;
+            if (g < beta) { upper = g; if (!white_turn) it_best = m; }
+            else { lower = g; if (white_turn) it_best = m; }
+        }
+        if (st->aborted) { g = score; break; } /* mantém a iteração anterior */
+        best = it_best;
+        score = g;
+        reached = depth;
+        flight_iteration(fr, depth, st->nodes, best, score);
+        if (info->iters < MAX_PLY) {
+            info->iter_best[info->iters] = best;
+            info->iter_score[info->iters] = score;
+            info->iter_ms[info->iters] = now_ms() - start;
+            info->iters++;
+        }
+        if (!AI_DETERMINISTIC && time_ms > 0 && now_ms() - start >= time_ms) break;
+    }
+    info->best = best;
+    info->score = score;
+    info->depth = reached;
+    info->nodes = st->nodes;
+    info->time_ms = now_ms() - start;
+    st->busy_ns = now_ns() - start_ns;
+    if (!AI_DETERMINISTIC) load_report_latency((double)info->time_ms);
+    metrics_record(info, 1, st->busy_ns);
+    if (reached == AI_DEPTH && !AI_DETERMINISTIC && result_cache_usable(bd)) {
+        re->key = key;
+        re->depth = reached;
+        re->move = transform_move(best, sym);
+    }
+    flight_end(fr, info);
+    return best;
+}
+
+/* Escolhe a jogada do lado white_turn; detalhes da busca ficam em last_search */
+Move choose_ai_move(Board *bd, int white_turn) {
+    if (AI_MTDF && AI_SKILL >= SKILL_MAX) return search_mtdf(bd, white_turn, &last_search);
+    return search_position(bd, white_turn, &last_search);
+}
+
+/* Converte coords para algébrico e imprime move */
+void print_move(Move m) {
+    char s[10];
+    s[0] = 'a' + m.f1;
+    s[1] = '0' + (8 - m.r1);
+    s[2] = '\0';
+    char t[10];
+    t[0] = 'a' + m.f2;
+    t[1] = '0' + (8 - m.r2);
+    t[2] = '\0';
+    if (m.promotion) printf("%s -> %s (promo %c)\n", s, t, m.promotion);
     else printf("%s -> %s\n", s , t);
 }
 
@@ -438,41 +2353,2709 @@ int parse_move_input(const char *line, Move *out) {
     return 1;
 }
 
-/* Compara dois movimentos (origem/destino/promo) */
-int moves_equal(Move a, Move b) {
-    return a.r1==b.r1 && a.f1==b.f1 && a.r2==b.r2 && a.f2==b.f2 && a.promotion==b.promotion;
+/* Jogada em notação de coordenadas ("e2e4", "e7e8q") */
+void move_to_str(Move m, char *out) {
+    out[0] = 'a' + m.f1;
+    out[1] = '0' + (8 - m.r1);
+    out[2] = 'a' + m.f2;
+    out[3] = '0' + (8 - m.r2);
+    out[4] = m.promotion ? tolower((unsigned char)m.promotion) : '\0';
+    out[5] = '\0';
 }
 
-/* Main loop */
-int main() {
+/* Notação algébrica curta (sem +/#) de uma jogada legal; promoção implícita vira dama */
+void move_to_san(Board *bd, int white_turn, Move m, char *out) {
+    char p = toupper((unsigned char)bd->cell[m.r1][m.f1]);
+    int capture = bd->cell[m.r2][m.f2] != '.';
+    int k = 0;
+    if (p == 'P') {
+        if (capture) { out[k++] = 'a' + m.f1; out[k++] = 'x'; }
+    } else {
+        /* desambiguação: coluna, senão fileira, senão as duas */
+        Move legal[MAX_MOVES];
+        int n = generate_legal_moves(bd, legal, white_turn), same = 0, same_file = 0, same_rank = 0;
+        for (int i=0;i<n;i++) {
+            Move l = legal[i];
+            if (l.r2 != m.r2 || l.f2 != m.f2 || (l.r1 == m.r1 && l.f1 == m.f1)) continue;
+            if (toupper((unsigned char)bd->cell[l.r1][l.f1]) != p) continue;
+            same++;
+            if (l.f1 == m.f1) same_file++;
+            if (l.r1 == m.r1) same_rank++;
+        }
+        out[k++] = p;
+        if (same && (!same_file || same_rank)) out[k++] = 'a' + m.f1;
+        if (same && same_file) out[k++] = '0' + (8 - m.r1);
+        if (capture) out[k++] = 'x';
+    }
+    out[k++] = 'a' + m.f2;
+    out[k++] = '0' + (8 - m.r2);
+    if (p == 'P' && (m.r2 == 0 || m.r2 == 7)) {
+        out[k++] = '=';
+        out[k++] = m.promotion ? toupper((unsigned char)m.promotion) : 'Q';
+    }
+    out[k] = '\0';
+}
+
+/* Confere se o texto (SAN com ou sem +#!?= ou coordenadas) descreve a jogada m */
+int move_matches_text(Board *bd, int white_turn, Move m, const char *text) {
+    char a[16], b[16];
+    int ka = 0, kb = 0;
+    move_to_san(bd, white_turn, m, b);
+    for (const char *p = text; *p && ka < 15; p++) if (!strchr("+#!?=", *p)) a[ka++] = *p;
+    a[ka] = '\0';
+    for (int i=0; b[i]; i++) if (b[i] != '=') b[kb++] = b[i];
+    b[kb] = '\0';
+    if (!strcmp(a, b)) return 1;
+    Move c;
+    return parse_move_input(text, &c) && c.r1 == m.r1 && c.f1 == m.f1 && c.r2 == m.r2 && c.f2 == m.f2
+        && (!c.promotion || c.promotion == (m.promotion ? m.promotion : 'Q'));
+}
+
+/* Procura entre as jogadas legais a que corresponde a m (origem/destino; promoção padrão: dama) */
+int find_legal_move(Board *bd, int white_turn, Move m, Move *out) {
+    Move legal[MAX_MOVES];
+    int n = generate_legal_moves(bd, legal, white_turn);
+    for (int i=0;i<n;i++) {
+        Move lm = legal[i];
+        if (lm.r1==m.r1 && lm.f1==m.f1 && lm.r2==m.r2 && lm.f2==m.f2) {
+            char mover = bd->cell[m.r1][m.f1];
+            lm.promotion = '\0';
+            if (toupper(mover) == 'P' && (m.r2==0 || m.r2==7)) lm.promotion = m.promotion ? m.promotion : 'Q';
+            *out = lm;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Lê uma posição em FEN. Roque e en-passant são aceitos mas ignorados (o motor não os
+   implementa); o relógio de meios-lances vai para o Board. Retorna 0 se o FEN for inválido. */
+int parse_fen(const char *fen, Board *bd, int *white_turn) {
+    int r = 0, f = 0;
+    const char *p = fen;
+    while (*p == ' ') p++;
+    for (; *p && *p != ' '; p++) {
+        if (*p == '/') { if (f != 8) return 0; r++; f = 0; continue; }
+        if (r > 7) return 0;
+        if (isdigit((unsigned char)*p)) {
+            for (int k=0; k<*p-'0'; k++) { if (f > 7) return 0; bd->cell[r][f++] = '.'; }
+        } else {
+            if (!strchr("PNBRQKpnbrqk", *p) || f > 7) return 0;
+            bd->cell[r][f++] = *p;
+        }
+    }
+    if (r != 7 || f != 8) return 0;
+    while (*p == ' ') p++;
+    *white_turn = *p != 'b';
+    bd->halfmove = 0;
+    /* campos seguintes: roque, en-passant, meios-lances, lance */
+    char castling[8], ep[8];
+    int half = 0;
+    if (*p && sscanf(p + 1, "%7s %7s %d", castling, ep, &half) == 3) bd->halfmove = half;
+    return 1;
+}
+
+void board_to_fen(Board *bd, int white_turn, char *out) {
+    int k = 0;
+    for (int r=0;r<8;r++) {
+        int empty = 0;
+        for (int f=0;f<8;f++) {
+            char c = bd->cell[r][f];
+            if (c == '.') { empty++; continue; }
+            if (empty) { out[k++] = '0' + empty; empty = 0; }
+            out[k++] = c;
+        }
+        if (empty) out[k++] = '0' + empty;
+        if (r < 7) out[k++] = '/';
+    }
+    sprintf(out + k, " %c - - %d 1", white_turn ? 'w' : 'b', bd->halfmove);
+}
+
+/* Despeja o gravador de voo, do registro mais antigo ao mais recente */
+void flight_dump(FILE *out) {
+    pthread_mutex_lock(&flight.lock);
+    long long last = flight.serial;
+    long long first = last - FLIGHT_RECORDS + 1 > 1 ? last - FLIGHT_RECORDS + 1 : 1;
+    fprintf(out, "== gravador de voo: %lld busca(s) registrada(s) ==\n", last - first + 1 > 0 ? last - first + 1 : 0);
+    for (long long s = first; s <= last; s++) {
+        FlightRecord *fr = &flight.rec[s % FLIGHT_RECORDS];
+        if (fr->serial != s) continue;
+        char fen[128], ms[8], when[32];
+        struct tm tmv;
+        board_to_fen(&fr->bd, fr->white_turn, fen);
+        move_to_str(fr->best, ms);
+        strftime(when, sizeof when, "%Y-%m-%d %H:%M:%S", localtime_r(&fr->wall, &tmv));
+        long long elapsed = fr->running ? now_ms() - fr->start_ms : fr->time_ms;
+        fprintf(out, "#%lld %s %s chave %016llx fen %s\n", s, when, fr->running ? "EM ANDAMENTO" : "concluida", fr->key, fen);
+        fprintf(out, "  limites: prof %d tempo %lld ms nos %lld escala %.2f threads %d\n",
+                fr->depth_limit, fr->time_limit, fr->node_limit, fr->scale, fr->threads);
+        fprintf(out, "  resultado: prof %d nos %lld tempo %lld ms melhor %s score %d\n",
+                fr->depth, fr->nodes, elapsed, fr->depth ? ms : "-", fr->score);
+        fprintf(out, "  iteracoes:");
+        for (int i=0;i<fr->iters;i++) {
+            int prev = i ? fr->iter_ms[i-1] : 0;
+            fprintf(out, " %d:%dms/%lld", i + 1, fr->iter_ms[i] - prev, fr->iter_nodes[i] - (i ? fr->iter_nodes[i-1] : 0));
+        }
+        fprintf(out, "\n");
+    }
+    pthread_mutex_unlock(&flight.lock);
+    fflush(out);
+}
+
+/* SIGUSR1 é bloqueado em todas as threads (a máscara é herdada) e atendido aqui, fora de
+   contexto de sinal, onde o despejo pode usar stdio e o mutex à vontade */
+void *flight_signal_main(void *arg) {
+    sigset_t *set = arg;
+    for (;;) {
+        int sig;
+        if (sigwait(set, &sig) == 0 && sig == SIGUSR1) flight_dump(stderr);
+    }
+    return NULL;
+}
+
+void flight_start(void) {
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, flight_signal_main, &set) == 0) pthread_detach(tid);
+}
+
+/* Mede a latência de despacho do pool: do "go" até cada worker começar a tarefa */
+long long dispatch_start[MAX_THREADS];
+
+void dispatch_probe(void *arg, int id) {
+    (void)arg;
+    dispatch_start[id] = now_ns();
+}
+
+int bench_dispatch(void) {
+    int nthreads = AI_THREADS < 2 ? 2 : AI_THREADS > MAX_THREADS ? MAX_THREADS : AI_THREADS;
+    int rounds = 2000;
+    double sum_all = 0, worst = 0;
+    pool_run(nthreads, dispatch_probe, NULL); /* cria os workers */
+    for (int k=0;k<rounds;k++) {
+        long long go = now_ns();
+        pool_run(nthreads, dispatch_probe, NULL);
+        long long last = go;
+        for (int t=1;t<nthreads;t++) if (dispatch_start[t] > last) last = dispatch_start[t];
+        double us = (last - go) / 1000.0;
+        sum_all += us;
+        if (us > worst) worst = us;
+    }
+    printf("threads %d: latencia media ate todos os workers iniciarem %.2f us (pior %.2f us)\n",
+           nthreads, sum_all / rounds, worst);
+    return 0;
+}
+
+const char *run_mode = "play";
+
+/* Servidor de análise. Escuta num socket Unix (ou TCP em 127.0.0.1) e aceita pedidos em
+   linhas "<id> <comando> [args]", vários por conexão sem esperar respostas:
+     <id> position startpos|fen <FEN> [moves e2e4 ...]   -> <id> ok
+     <id> move e2e4 / <id> validate e2e4                 -> <id> ok | legal | illegal | error ...
+     <id> search [depth N] [nodes N] [time MS]           -> <id> bestmove e7e5 score S depth D nodes N time MS
+     <id> rootsearch e2e4 depth D alpha A beta B         -> <id> rootscore e2e4 score S nodes N
+     <id> newgame / <id> shutdown                        -> <id> ok
+   Um único thread de E/S multiplexa as conexões com epoll e responde na hora aos comandos
+   baratos; buscas (e newgame, que mexe no hash) vão para uma fila atendida pelo thread de
+   busca, que usa o pool de threads de busca. As respostas voltam pelo id, fora de ordem,
+   e o thread de E/S é acordado por um eventfd. No shutdown, buscas ainda na fila são
+   descartadas sem resposta; a que está em andamento termina e é respondida. */
+#define SERVER_MAX_FDS 4096
+#define SERVER_IN_MAX 65536
+
+typedef struct {
+    int fd;
+    unsigned serial;  /* distingue conexões que reaproveitam o mesmo fd */
+    char *in;
+    size_t in_len;
+    char *out;
+    size_t out_len, out_cap;
+    int want_out;     /* EPOLLOUT registrado */
     Board bd;
-    init_board(&bd);
-    int white_turn = 1; /* humano joga brancas inicialmente */
-    char input[64];
+    int white_turn;
+} Conn;
 
-    printf("Bem-vindo ao MateCheck (versao simplificada) — Jogador = Brancas\n");
-    printf("Formato de entrada: e2e4 ou e2 e4. Para sair, digite 'quit'.\n");
-    printf("Nota: sem roque e sem en-passant. Promocao para Q/R/B/N.\n\n");
+#define JOB_SEARCH 0
+#define JOB_NEWGAME 1
+#define JOB_ROOTMOVE 2 /* uma jogada da raiz para o coordenador distribuído */
+typedef struct SearchJob {
+    int kind;
+    Move root_move;
+    int alpha, beta;
+    int fd;
+    unsigned serial;
+    char id[64];
+    Board bd;
+    int white_turn;
+    int depth, time_ms;
+    long long nodes;
+    char reply[256];
+    struct SearchJob *next;
+} SearchJob;
 
-    while (1) {
-        print_board(&bd);
-        /* checar fim de jogo */
-        Move legalMoves[MAX_MOVES];
-        int nmoves = generate_legal_moves(&bd, legalMoves, white_turn);
-        if (nmoves == 0) {
-            if (is_in_check(&bd, white_turn)) {
-                if (white_turn) printf("XEQUE-MATE! Pretas vencem.\n"); else printf("XEQUE-MATE! Brancas vencem.\n");
-            } else {
-                printf("Empate por stalemate!\n");
-            }
-            break;
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    SearchJob *head, *tail;          /* pedidos aguardando o thread de busca */
+    int pending;
+    SearchJob *done_head, *done_tail; /* respostas prontas para o thread de E/S */
+    int event_fd;
+    int quit;
+} ServerQueues;
+
+ServerQueues srvq = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+Conn *conns[SERVER_MAX_FDS];
+unsigned conn_serial = 0;
+const char *server_path = NULL;
+int server_port = 0;
+
+void server_enqueue(SearchJob *job) {
+    pthread_mutex_lock(&srvq.lock);
+    job->next = NULL;
+    if (srvq.tail) srvq.tail->next = job; else srvq.head = job;
+    srvq.tail = job;
+    srvq.pending++;
+    load_report_queue(srvq.pending);
+    pthread_cond_signal(&srvq.cond);
+    pthread_mutex_unlock(&srvq.lock);
+}
+
+/* Thread de busca: único dono do estado do motor (opções, hash, pool) durante o servidor */
+void *server_search_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&srvq.lock);
+        while (!srvq.head && !srvq.quit) pthread_cond_wait(&srvq.cond, &srvq.lock);
+        SearchJob *job = srvq.head;
+        if (!job) { pthread_mutex_unlock(&srvq.lock); return NULL; }
+        srvq.head = job->next;
+        if (!srvq.head) srvq.tail = NULL;
+        srvq.pending--;
+        load_report_queue(srvq.pending);
+        pthread_mutex_unlock(&srvq.lock);
+
+        if (job->kind == JOB_NEWGAME) {
+            tt_new_generation();
+            snprintf(job->reply, sizeof job->reply, "%s ok\n", job->id);
+        } else if (job->kind == JOB_ROOTMOVE) {
+            SearchThread *st = prepare_single_search();
+            Board child = job->bd;
+            apply_move(&child, job->root_move);
+            int sc = minimax(st, &child, job->depth > 0 ? job->depth - 1 : 0, job->alpha, job->beta, !job->white_turn);
+            char ms[8];
+            move_to_str(job->root_move, ms);
+            snprintf(job->reply, sizeof job->reply, "%s rootscore %s score %d nodes %lld\n", job->id, ms, sc, st->nodes);
+        } else {
+            int save_depth = AI_DEPTH, save_time = AI_TIME_MS;
+            long long save_nodes = AI_NODES;
+            if (job->depth > 0) AI_DEPTH = job->depth;
+            if (job->time_ms > 0) AI_TIME_MS = job->time_ms;
+            if (job->nodes > 0) AI_NODES = job->nodes;
+            SearchInfo info;
+            Move m = search_position(&job->bd, job->white_turn, &info);
+            AI_DEPTH = save_depth; AI_TIME_MS = save_time; AI_NODES = save_nodes;
+            char ms[8];
+            if (m.r1 == m.r2 && m.f1 == m.f2) strcpy(ms, "none");
+            else move_to_str(m, ms);
+            snprintf(job->reply, sizeof job->reply, "%s bestmove %s score %d depth %d nodes %lld time %lld\n",
+                     job->id, ms, info.score, info.depth, info.nodes, info.time_ms);
         }
+        pthread_mutex_lock(&srvq.lock);
+        job->next = NULL;
+        if (srvq.done_tail) srvq.done_tail->next = job; else srvq.done_head = job;
+        srvq.done_tail = job;
+        pthread_mutex_unlock(&srvq.lock);
+        unsigned long long one = 1;
+        if (write(srvq.event_fd, &one, sizeof one) < 0) perror("eventfd");
+    }
+}
 
-        if (white_turn) {
-            /* jogador humano */
-            printf("\nSua vez (brancas). Entre sua jogada: ");
-            if (!fgets(input, sizeof(input), stdin)) break;
+void conn_close(int ep, Conn *c) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    conns[c->fd] = NULL;
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+/* Escreve o que puder; o resto fica no buffer com EPOLLOUT ligado. Retorna 0 se a conexão caiu. */
+int conn_flush(int ep, Conn *c) {
+    size_t off = 0;
+    while (off < c->out_len) {
+        ssize_t w = send(c->fd, c->out + off, c->out_len - off, MSG_NOSIGNAL);
+        if (w > 0) { off += (size_t)w; continue; }
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (w < 0 && errno == EINTR) continue;
+        return 0;
+    }
+    memmove(c->out, c->out + off, c->out_len - off);
+    c->out_len -= off;
+    int want = c->out_len > 0;
+    if (want != c->want_out) {
+        struct epoll_event ev = {.events = EPOLLIN | (want ? EPOLLOUT : 0), .data.fd = c->fd};
+        epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_out = want;
+    }
+    return 1;
+}
+
+void conn_send(Conn *c, const char *text) {
+    size_t len = strlen(text);
+    if (c->out_len + len > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap : 4096;
+        while (cap < c->out_len + len) cap *= 2;
+        char *nb = realloc(c->out, cap);
+        if (!nb) return;
+        c->out = nb;
+        c->out_cap = cap;
+    }
+    memcpy(c->out + c->out_len, text, len);
+    c->out_len += len;
+}
+
+/* Entrega as respostas prontas às conexões que ainda são as mesmas do pedido e libera os jobs */
+void server_deliver(int ep) {
+    pthread_mutex_lock(&srvq.lock);
+    SearchJob *job = srvq.done_head;
+    srvq.done_head = srvq.done_tail = NULL;
+    pthread_mutex_unlock(&srvq.lock);
+    while (job) {
+        SearchJob *next = job->next;
+        Conn *c = conns[job->fd];
+        if (c && c->serial == job->serial) {
+            conn_send(c, job->reply);
+            if (!conn_flush(ep, c)) conn_close(ep, c);
+        }
+        free(job);
+        job = next;
+    }
+}
+
+void conn_reply(Conn *c, const char *id, const char *msg) {
+    char buf[512];
+    snprintf(buf, sizeof buf, "%s %s\n", id, msg);
+    conn_send(c, buf);
+}
+
+/* Aplica "e2e4"-like à posição da conexão; 0 se ilegal */
+int conn_play(Conn *c, const char *tok) {
+    Move m, lm;
+    if (!parse_move_input(tok, &m) || !find_legal_move(&c->bd, c->white_turn, m, &lm)) return 0;
+    apply_move(&c->bd, lm);
+    c->white_turn = !c->white_turn;
+    return 1;
+}
+
+/* Trata uma linha de pedido; retorna 1 se o servidor deve encerrar */
+int server_handle_line(Conn *c, char *line) {
+    char *save = NULL;
+    char *id = strtok_r(line, " \t\r", &save);
+    if (!id) return 0;
+    char *cmd = strtok_r(NULL, " \t\r", &save);
+    if (!cmd) { conn_reply(c, id, "error comando ausente"); return 0; }
+
+    if (!strcmp(cmd, "position")) {
+        char *rest = save ? save : (char *)"";
+        while (*rest == ' ') rest++;
+        Board nb;
+        int wt = 1;
+        char *moves = strstr(rest, " moves");
+        if (moves) *moves = '\0';
+        if (!strncmp(rest, "startpos", 8)) init_board(&nb);
+        else if (!strncmp(rest, "fen ", 4) && parse_fen(rest + 4, &nb, &wt)) {}
+        else { conn_reply(c, id, "error posicao invalida"); return 0; }
+        Board old = c->bd;
+        int old_wt = c->white_turn;
+        c->bd = nb;
+        c->white_turn = wt;
+        if (moves) {
+            char *s2 = NULL;
+            for (char *t = strtok_r(moves + 6, " \t\r", &s2); t; t = strtok_r(NULL, " \t\r", &s2)) {
+                if (!conn_play(c, t)) {
+                    c->bd = old;
+                    c->white_turn = old_wt;
+                    conn_reply(c, id, "error jogada ilegal na lista");
+                    return 0;
+                }
+            }
+        }
+        conn_reply(c, id, "ok");
+    } else if (!strcmp(cmd, "move") || !strcmp(cmd, "validate")) {
+        char *tok = strtok_r(NULL, " \t\r", &save);
+        Move m, lm;
+        int legal = tok && parse_move_input(tok, &m) && find_legal_move(&c->bd, c->white_turn, m, &lm);
+        if (!strcmp(cmd, "validate")) conn_reply(c, id, legal ? "legal" : "illegal");
+        else if (!legal) conn_reply(c, id, "error jogada ilegal");
+        else { conn_play(c, tok); conn_reply(c, id, "ok"); }
+    } else if (!strcmp(cmd, "search") || !strcmp(cmd, "newgame") || !strcmp(cmd, "rootsearch")) {
+        SearchJob *job = calloc(1, sizeof *job);
+        if (!job) { conn_reply(c, id, "error sem memoria"); return 0; }
+        job->kind = !strcmp(cmd, "newgame") ? JOB_NEWGAME : !strcmp(cmd, "search") ? JOB_SEARCH : JOB_ROOTMOVE;
+        if (job->kind == JOB_ROOTMOVE) {
+            char *tok = strtok_r(NULL, " \t\r", &save);
+            Move m;
+            if (!tok || !parse_move_input(tok, &m) || !find_legal_move(&c->bd, c->white_turn, m, &job->root_move)) {
+                free(job);
+                conn_reply(c, id, "error jogada ilegal");
+                return 0;
+            }
+            job->alpha = INT_MIN/2;
+            job->beta = INT_MAX/2;
+        }
+        job->fd = c->fd;
+        job->serial = c->serial;
+        snprintf(job->id, sizeof job->id, "%s", id);
+        job->bd = c->bd; /* cópia: jogadas pedidas depois não afetam esta busca */
+        job->white_turn = c->white_turn;
+        if (job->kind == JOB_NEWGAME) { init_board(&c->bd); c->white_turn = 1; }
+        for (char *k = strtok_r(NULL, " \t\r", &save); k; k = strtok_r(NULL, " \t\r", &save)) {
+            char *v = strtok_r(NULL, " \t\r", &save);
+            if (!v) break;
+            if (!strcmp(k, "depth")) job->depth = atoi(v);
+            else if (!strcmp(k, "nodes")) job->nodes = atoll(v);
+            else if (!strcmp(k, "time")) job->time_ms = atoi(v);
+            else if (!strcmp(k, "alpha")) job->alpha = atoi(v);
+            else if (!strcmp(k, "beta")) job->beta = atoi(v);
+        }
+        server_enqueue(job);
+    } else if (!strcmp(cmd, "shutdown")) {
+        conn_reply(c, id, "ok");
+        return 1;
+    } else {
+        conn_reply(c, id, "error comando desconhecido");
+    }
+    return 0;
+}
+
+int server_listen(void) {
+    int fd;
+    if (server_path) {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sun_family = AF_UNIX;
+        snprintf(sa.sun_path, sizeof sa.sun_path, "%s", server_path);
+        unlink(server_path);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof sa) < 0) { perror("bind"); return -1; }
+    } else {
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((unsigned short)server_port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof sa) < 0) { perror("bind"); return -1; }
+    }
+    if (listen(fd, 128) < 0) { perror("listen"); return -1; }
+    return fd;
+}
+
+int run_server(void) {
+    int lfd = server_listen();
+    if (lfd < 0) return 1;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    srvq.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = lfd};
+    epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &ev);
+    ev.data.fd = srvq.event_fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, srvq.event_fd, &ev);
+    pthread_t searcher;
+    pthread_create(&searcher, NULL, server_search_main, NULL);
+    if (server_path) fprintf(stderr, "Servidor escutando em %s\n", server_path);
+    else fprintf(stderr, "Servidor escutando em 127.0.0.1:%d\n", server_port);
+
+    int quit = 0;
+    struct epoll_event evs[64];
+    while (!quit) {
+        int nev = epoll_wait(ep, evs, 64, -1);
+        if (nev < 0) { if (errno == EINTR) continue; perror("epoll_wait"); break; }
+        for (int e=0; e<nev; e++) {
+            int fd = evs[e].data.fd;
+            if (fd == lfd) {
+                int cfd;
+                while ((cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    Conn *c = cfd < SERVER_MAX_FDS ? calloc(1, sizeof *c) : NULL;
+                    if (c) c->in = malloc(SERVER_IN_MAX);
+                    if (!c || !c->in) { free(c); close(cfd); continue; }
+                    c->fd = cfd;
+                    c->serial = ++conn_serial;
+                    init_board(&c->bd);
+                    c->white_turn = 1;
+                    conns[cfd] = c;
+                    struct epoll_event cev = {.events = EPOLLIN, .data.fd = cfd};
+                    epoll_ctl(ep, EPOLL_CTL_ADD, cfd, &cev);
+                }
+            } else if (fd == srvq.event_fd) {
+                unsigned long long cnt;
+                if (read(srvq.event_fd, &cnt, sizeof cnt) < 0 && errno != EAGAIN) perror("eventfd");
+                server_deliver(ep);
+            } else {
+                Conn *c = conns[fd];
+                if (!c) continue;
+                int alive = 1;
+                if (evs[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    for (;;) {
+                        if (c->in_len == SERVER_IN_MAX) { alive = 0; break; } /* linha grande demais */
+                        ssize_t r = read(fd, c->in + c->in_len, SERVER_IN_MAX - c->in_len);
+                        if (r > 0) { c->in_len += (size_t)r; continue; }
+                        if (r < 0 && errno == EINTR) continue;
+                        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) alive = 0;
+                        break;
+                    }
+                    /* processa todas as linhas completas: pedidos em pipeline */
+                    size_t start = 0;
+                    for (size_t i=0; i<c->in_len && !quit; i++) {
+                        if (c->in[i] != '\n') continue;
+                        c->in[i] = '\0';
+                        quit = server_handle_line(c, c->in + start);
+                        start = i + 1;
+                    }
+                    memmove(c->in, c->in + start, c->in_len - start);
+                    c->in_len -= start;
+                }
+                if (!conn_flush(ep, c) || !alive) conn_close(ep, c);
+            }
+        }
+    }
+    /* pedidos ainda na fila são descartados sem busca; o que está em andamento termina e é respondido */
+    pthread_mutex_lock(&srvq.lock);
+    srvq.quit = 1;
+    SearchJob *job = srvq.head;
+    srvq.head = srvq.tail = NULL;
+    srvq.pending = 0;
+    load_report_queue(0);
+    pthread_cond_signal(&srvq.cond);
+    pthread_mutex_unlock(&srvq.lock);
+    while (job) {
+        SearchJob *next = job->next;
+        free(job);
+        job = next;
+    }
+    pthread_join(searcher, NULL);
+    server_deliver(ep);
+    for (int fd=0; fd<SERVER_MAX_FDS; fd++) if (conns[fd]) { conn_flush(ep, conns[fd]); conn_close(ep, conns[fd]); }
+    close(lfd);
+    if (server_path) unlink(server_path);
+    return 0;
+}
+
+/* Leitura em lote de arquivos grandes (suítes EPD, corpus, arquivos PGN). Mantém
+   BULK_DEPTH leituras de BULK_CHUNK bytes em voo no io_uring, em offsets consecutivos, e
+   entrega linhas como fatias apontando para dentro dos buffers (só a linha que cruza o fim de
+   um bloco é copiada). Sem io_uring (kernel antigo, seccomp) ou para pipes e terminais, os
+   mesmos buffers são preenchidos com read(). As chamadas de sistema são feitas à mão, sem
+   liburing. */
+#define BULK_DEPTH 4
+#define BULK_CHUNK (1 << 20)
+#define BULK_PENDING -1 /* leitura ainda em voo */
+#define BULK_ERROR -2
+
+typedef struct {
+    int fd;
+    int uring;               /* 1 = io_uring, 0 = read() */
+    long long size;          /* tamanho do arquivo regular (io_uring) */
+    char *buf[BULK_DEPTH];
+    long long want[BULK_DEPTH]; /* bytes pedidos em cada bloco */
+    long long got[BULK_DEPTH];  /* resultado da leitura (BULK_PENDING = ainda em voo) */
+    long long next_off;      /* offset do próximo bloco a submeter */
+    long long chunk;         /* índice do bloco em consumo */
+    char *cur;               /* bloco em consumo */
+    size_t pos, len;
+    int eof;
+    char *carry;             /* linha que cruzou a fronteira entre blocos */
+    size_t carry_len, carry_cap;
+    int error;               /* sem memória para a linha: leitura interrompida */
+    /* io_uring */
+    int ring;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_sz, cq_sz, sqes_sz;
+} BulkReader;
+
+int bulk_uring_disabled = 0; /* --no-uring */
+
+static int bulk_uring_setup(BulkReader *r) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    r->ring = (int)syscall(__NR_io_uring_setup, BULK_DEPTH, &p);
+    if (r->ring < 0) return 0;
+    r->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) r->sq_sz = r->cq_sz = r->sq_sz > r->cq_sz ? r->sq_sz : r->cq_sz;
+    r->sq_ptr = mmap(NULL, r->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_SQ_RING);
+    r->cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP) ? r->sq_ptr
+              : mmap(NULL, r->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_CQ_RING);
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_SQES);
+    if (r->sq_ptr == MAP_FAILED || r->cq_ptr == MAP_FAILED || r->sqes == MAP_FAILED) {
+        if (r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_sz);
+        if (r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_sz);
+        if (r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_sz);
+        close(r->ring);
+        return 0;
+    }
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 1;
+}
+
+/* Submete a leitura do próximo bloco no slot dado */
+static void bulk_submit(BulkReader *r, int slot) {
+    long long left = r->size - r->next_off;
+    r->want[slot] = left < BULK_CHUNK ? (left > 0 ? left : 0) : BULK_CHUNK;
+    r->got[slot] = BULK_PENDING;
+    if (r->want[slot] == 0) { r->got[slot] = 0; return; }
+    unsigned tail = *r->sq_tail, idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->fd;
+    sqe->addr = (unsigned long long)(uintptr_t)r->buf[slot];
+    sqe->len = (unsigned)r->want[slot];
+    sqe->off = (unsigned long long)r->next_off;
+    sqe->user_data = (unsigned long long)slot;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->next_off += r->want[slot];
+    syscall(__NR_io_uring_enter, r->ring, 1, 0, 0, NULL, 0);
+}
+
+/* Recolhe conclusões da fila; com wait, bloqueia até haver ao menos uma */
+static void bulk_reap(BulkReader *r, int wait) {
+    unsigned head = *r->cq_head, tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail && wait) {
+        syscall(__NR_io_uring_enter, r->ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        r->got[cqe->user_data] = cqe->res < 0 ? BULK_ERROR : cqe->res;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* Espera o bloco em consumo; leituras curtas ou com erro são completadas com pread */
+static long long bulk_wait(BulkReader *r, int slot) {
+    while (r->got[slot] == BULK_PENDING) bulk_reap(r, 1);
+    long long got = r->got[slot] < 0 ? 0 : r->got[slot];
+    long long base = r->chunk * (long long)BULK_CHUNK;
+    while (got < r->want[slot]) {
+        ssize_t n = pread(r->fd, r->buf[slot] + got, r->want[slot] - got, base + got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    return got;
+}
+
+void bulk_close(BulkReader *r) {
+    if (r->uring) {
+        /* o kernel ainda pode escrever nos buffers: espera as leituras em voo antes de soltá-los */
+        for (int s=0;s<BULK_DEPTH;s++) while (r->got[s] == BULK_PENDING) bulk_reap(r, 1);
+        munmap(r->sqes, r->sqes_sz);
+        if (r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_sz);
+        munmap(r->sq_ptr, r->sq_sz);
+        close(r->ring);
+    }
+    for (int s=0;s<BULK_DEPTH;s++) free(r->buf[s]);
+    free(r->carry);
+    if (r->fd > 0) close(r->fd);
+}
+
+int bulk_open(BulkReader *r, const char *path) {
+    memset(r, 0, sizeof *r);
+    r->fd = !strcmp(path, "-") ? 0 : open(path, O_RDONLY | O_CLOEXEC);
+    if (r->fd < 0) return 0;
+    for (int s=0;s<BULK_DEPTH;s++) {
+        r->buf[s] = malloc(BULK_CHUNK);
+        if (!r->buf[s]) { bulk_close(r); return 0; } /* solta o fd e os buffers já alocados */
+    }
+    struct stat stt;
+    if (!bulk_uring_disabled && fstat(r->fd, &stt) == 0 && S_ISREG(stt.st_mode) && bulk_uring_setup(r)) {
+        r->uring = 1;
+        r->size = stt.st_size;
+        for (int s=0;s<BULK_DEPTH;s++) bulk_submit(r, s);
+    }
+    r->chunk = -1;
+    return 1;
+}
+
+/* Passa ao próximo bloco; 0 no fim do arquivo */
+static int bulk_advance(BulkReader *r) {
+    if (r->eof) return 0;
+    if (r->uring && r->chunk >= 0) bulk_submit(r, (int)(r->chunk % BULK_DEPTH)); /* o bloco consumido volta para a fila */
+    r->chunk++;
+    int slot = (int)(r->chunk % BULK_DEPTH);
+    long long got;
+    if (r->uring) got = bulk_wait(r, slot);
+    else {
+        do got = read(r->fd, r->buf[slot], BULK_CHUNK); while (got < 0 && errno == EINTR);
+    }
+    if (got <= 0) { r->eof = 1; return 0; }
+    r->cur = r->buf[slot];
+    r->pos = 0;
+    r->len = (size_t)got;
+    return 1;
+}
+
+/* Acumula um pedaço da linha corrente; 0 (e r->error) se não há memória */
+static int bulk_carry(BulkReader *r, const char *s, size_t n) {
+    if (r->carry_len + n > r->carry_cap) {
+        size_t cap = (r->carry_len + n) * 2;
+        char *nc = realloc(r->carry, cap);
+        if (!nc) {
+            fprintf(stderr, "Sem memoria para uma linha de %zu bytes\n", r->carry_len + n);
+            r->error = 1;
+            return 0;
+        }
+        r->carry = nc;
+        r->carry_cap = cap;
+    }
+    memcpy(r->carry + r->carry_len, s, n);
+    r->carry_len += n;
+    return 1;
+}
+
+/* Próxima linha (sem '\n' e sem '\r' final) como fatia válida até a próxima chamada; 0 no
+   fim do arquivo ou depois de um erro (r->error) */
+int bulk_next_line(BulkReader *r, const char **line, size_t *n) {
+    r->carry_len = 0;
+    if (r->error) return 0;
+    for (;;) {
+        if (r->cur && r->pos < r->len) {
+            char *start = r->cur + r->pos, *nl = memchr(start, '\n', r->len - r->pos);
+            if (nl) {
+                size_t k = (size_t)(nl - start);
+                r->pos += k + 1;
+                if (r->carry_len) {
+                    if (!bulk_carry(r, start, k)) return 0;
+                    *line = r->carry;
+                    k = r->carry_len;
+                }
+                else *line = start;
+                if (k && (*line)[k-1] == '\r') k--;
+                *n = k;
+                return 1;
+            }
+            if (!bulk_carry(r, start, r->len - r->pos)) return 0;
+            r->pos = r->len;
+        }
+        if (!bulk_advance(r)) {
+            if (!r->carry_len) return 0;
+            *line = r->carry;
+            *n = r->carry_len;
+            if ((*line)[*n - 1] == '\r') (*n)--;
+            return 1;
+        }
+    }
+}
+
+/* Compara a vazão de linhas: stdio (getline), leitor em lote com io_uring e com read().
+   Cada método roda com o arquivo fora do cache de páginas (POSIX_FADV_DONTNEED) e depois
+   com ele em cache. */
+const char *bench_read_file = NULL; /* --bench-read ARQUIVO */
+
+static void bench_read_drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static long long bench_read_pass(const char *path, int method, long long *bytes) {
+    long long lines = 0;
+    *bytes = 0;
+    if (method == 0) {
+        FILE *f = fopen(path, "r");
+        if (!f) return -1;
+        char *line = NULL;
+        size_t cap = 0;
+        ssize_t n;
+        while ((n = getline(&line, &cap, f)) >= 0) { lines++; *bytes += n; }
+        free(line);
+        fclose(f);
+        return lines;
+    }
+    BulkReader r;
+    bulk_uring_disabled = method == 2;
+    if (!bulk_open(&r, path)) return -1;
+    const char *s;
+    size_t n;
+    while (bulk_next_line(&r, &s, &n)) { lines++; *bytes += n + 1; }
+    if (method == 1 && !r.uring) printf("(io_uring indisponivel: usando read)\n");
+    bulk_close(&r);
+    bulk_uring_disabled = 0;
+    return lines;
+}
+
+int run_bench_read(void) {
+    const char *names[3] = {"stdio getline", "lote io_uring", "lote read()"};
+    printf("%-14s %-6s %12s %10s %10s\n", "metodo", "cache", "linhas", "ms", "MB/s");
+    for (int cached=0; cached<2; cached++) {
+        for (int m=0;m<3;m++) {
+            if (!cached) bench_read_drop_cache(bench_read_file);
+            long long bytes, t0 = now_ms();
+            long long lines = bench_read_pass(bench_read_file, m, &bytes);
+            long long ms = now_ms() - t0;
+            if (lines < 0) { fprintf(stderr, "Nao foi possivel ler %s\n", bench_read_file); return 1; }
+            printf("%-14s %-6s %12lld %10lld %10.0f\n", names[m], cached ? "quente" : "frio", lines, ms,
+                   ms ? bytes / 1048576.0 * 1000.0 / ms : 0.0);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
+
+/* Tokens de lance de um arquivo PGN lido em lote; comentários {} podem cruzar linhas */
+typedef struct {
+    BulkReader br;
+    const char *p, *end;
+    int in_comment;
+} PgnReader;
+
+int pgn_open(PgnReader *pr, const char *path) {
+    memset(pr, 0, sizeof *pr);
+    return bulk_open(&pr->br, path);
+}
+
+void pgn_close(PgnReader *pr) {
+    bulk_close(&pr->br);
+}
+
+/* Lê o próximo lance, pulando números de lance e comentários. Resultados e cabeçalhos PGN
+   marcam fim de partida: retorna 1 com *game_end ligado. */
+int pgn_next_token(PgnReader *pr, char *tok, size_t sz, int *game_end) {
+    *game_end = 0;
+    for (;;) {
+        if (pr->p >= pr->end) {
+            size_t n;
+            if (!bulk_next_line(&pr->br, &pr->p, &n)) return 0;
+            pr->end = pr->p + n;
+            continue;
+        }
+        char c = *pr->p;
+        if (pr->in_comment) { pr->in_comment = c != '}'; pr->p++; continue; }
+        if (isspace((unsigned char)c)) { pr->p++; continue; }
+        if (c == '{') { pr->in_comment = 1; pr->p++; continue; }
+        if (c == ';' || c == '%') { pr->p = pr->end; continue; } /* comentário até o fim da linha */
+        if (c == '[') { pr->p = pr->end; *game_end = 1; return 1; } /* cabeçalho */
+        size_t k = 0;
+        while (pr->p < pr->end && !isspace((unsigned char)*pr->p) && *pr->p != '{') {
+            if (k + 1 < sz) tok[k++] = *pr->p;
+            pr->p++;
+        }
+        tok[k] = '\0';
+        char *dot = strrchr(tok, '.');
+        if (dot) memmove(tok, dot + 1, strlen(dot + 1) + 1); /* "12." ou "12...e5" */
+        if (!tok[0]) continue;
+        if (!strcmp(tok, "1-0") || !strcmp(tok, "0-1") || !strcmp(tok, "1/2-1/2") || !strcmp(tok, "*")) *game_end = 1;
+        return 1;
+    }
+}
+
+/* Busca distribuída: um coordenador divide a raiz entre processos trabalhadores (servidores
+   iniciados com --server-tcp) e troca só posições, janelas e scores pelo socket. A cada
+   iteração a melhor jogada da iteração anterior é buscada primeiro, com janela cheia; as
+   demais saem com a janela limitada pelo melhor score já recebido, que vai apertando à
+   medida que os resultados voltam. Jogadas que falham baixo só informam um limite. */
+typedef struct {
+    int fd;
+    char buf[8192];
+    size_t len;
+    int job;   /* índice da jogada em andamento, -1 = livre */
+} DistWorker;
+
+int dist_connect(const char *host, int port) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, host, &sa.sin_addr) != 1) return -1;
+    for (int tries=0; tries<50; tries++) { /* trabalhadores recém-criados podem ainda não escutar */
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr *)&sa, sizeof sa) == 0) return fd;
+        close(fd);
+        struct timespec ts = {0, 100 * 1000000L};
+        nanosleep(&ts, NULL);
+    }
+    return -1;
+}
+
+int dist_send(DistWorker *w, const char *text) {
+    size_t len = strlen(text), off = 0;
+    while (off < len) {
+        ssize_t r = send(w->fd, text + off, len - off, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        off += (size_t)r;
+    }
+    return 1;
+}
+
+/* Lê uma linha completa (bloqueia até chegar); 0 se a conexão caiu */
+int dist_readline(DistWorker *w, char *line, size_t sz) {
+    for (;;) {
+        char *nl = memchr(w->buf, '\n', w->len);
+        if (nl) {
+            size_t n = (size_t)(nl - w->buf);
+            if (n >= sz) n = sz - 1;
+            memcpy(line, w->buf, n);
+            line[n] = '\0';
+            w->len -= (size_t)(nl - w->buf) + 1;
+            memmove(w->buf, nl + 1, w->len);
+            return 1;
+        }
+        if (w->len == sizeof w->buf) return 0;
+        ssize_t r = recv(w->fd, w->buf + w->len, sizeof w->buf - w->len, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        w->len += (size_t)r;
+    }
+}
+
+/* Envia um pedido e espera a resposta de mesmo id (usado fora do laço de busca) */
+int dist_request(DistWorker *w, const char *req) {
+    char line[512];
+    if (!dist_send(w, req)) return 0;
+    return dist_readline(w, line, sizeof line) && strstr(line, " ok") != NULL;
+}
+
+int dist_send_job(DistWorker *w, int idx, Move m, int depth, int alpha, int beta) {
+    char req[128], ms[8];
+    move_to_str(m, ms);
+    snprintf(req, sizeof req, "%d rootsearch %s depth %d alpha %d beta %d\n", idx, ms, depth, alpha, beta);
+    w->job = idx;
+    return dist_send(w, req);
+}
+
+/* Aprofundamento iterativo distribuído até depth; retorna 0 se algum trabalhador caiu */
+int dist_search(DistWorker *ws, int nw, Board *bd, int white_turn, int depth,
+                Move *best_out, int *score_out, long long *nodes_out) {
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES], order[MAX_MOVES];
+    int n = generate_legal_moves(bd, moves, white_turn);
+    *nodes_out = 0;
+    if (n == 0) return 1;
+    char fen[128], req[256];
+    board_to_fen(bd, white_turn, fen);
+    snprintf(req, sizeof req, "0 position fen %s\n", fen);
+    for (int k=0;k<nw;k++) if (!dist_request(&ws[k], req)) return 0;
+    for (int i=0;i<n;i++) { order[i] = i; scores[i] = 0; }
+    int best = 0;
+    for (int d=1; d<=depth; d++) {
+        /* melhor jogada anterior primeiro, depois por score */
+        for (int i=1;i<n;i++) {
+            int o = order[i], j = i - 1;
+            while (j >= 0 && (white_turn ? scores[order[j]] < scores[o] : scores[order[j]] > scores[o])) { order[j+1] = order[j]; j--; }
+            order[j+1] = o;
+        }
+        int bound = white_turn ? INT_MIN/2 : INT_MAX/2;
+        int next = 0, done = 0, pv_done = 0;
+        best = order[0];
+        while (done < n) {
+            /* a primeira jogada vai sozinha: o score dela é o limite que as outras herdam */
+            for (int k=0; k<nw && next < n && (pv_done || next == 0); k++) {
+                if (ws[k].job >= 0) continue;
+                int alpha = white_turn ? bound : INT_MIN/2, beta = white_turn ? INT_MAX/2 : bound;
+                if (!dist_send_job(&ws[k], order[next], moves[order[next]], d, alpha, beta)) return 0;
+                next++;
+            }
+            struct pollfd pfd[MAX_THREADS];
+            for (int k=0;k<nw;k++) { pfd[k].fd = ws[k].fd; pfd[k].events = POLLIN; pfd[k].revents = 0; }
+            int buffered = 0;
+            for (int k=0;k<nw;k++) if (ws[k].job >= 0 && memchr(ws[k].buf, '\n', ws[k].len)) buffered = 1;
+            if (!buffered && poll(pfd, nw, -1) < 0 && errno != EINTR) return 0;
+            for (int k=0;k<nw;k++) {
+                if (ws[k].job < 0 || !(buffered ? memchr(ws[k].buf, '\n', ws[k].len) != NULL : (pfd[k].revents & (POLLIN | POLLHUP | POLLERR)))) continue;
+                char line[256];
+                if (!dist_readline(&ws[k], line, sizeof line)) return 0;
+                int idx, sc;
+                long long nodes;
+                char ms[8];
+                if (sscanf(line, "%d rootscore %7s score %d nodes %lld", &idx, ms, &sc, &nodes) != 4 || idx != ws[k].job) return 0;
+                ws[k].job = -1;
+                scores[idx] = sc;
+                *nodes_out += nodes;
+                if (white_turn ? sc > bound : sc < bound) { bound = sc; best = idx; }
+                if (idx == order[0]) pv_done = 1;
+                done++;
+            }
+        }
+    }
+    *best_out = moves[best];
+    *score_out = scores[best];
+    return 1;
+}
+
+/* Lista "host:porta,host:porta" de trabalhadores */
+int dist_connect_list(const char *list, DistWorker *ws, int max) {
+    char buf[1024];
+    snprintf(buf, sizeof buf, "%s", list);
+    int nw = 0;
+    char *save = NULL;
+    for (char *t = strtok_r(buf, ",", &save); t && nw < max; t = strtok_r(NULL, ",", &save)) {
+        char *colon = strrchr(t, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        ws[nw].fd = dist_connect(t, atoi(colon + 1));
+        if (ws[nw].fd < 0) { fprintf(stderr, "Sem conexao com %s:%s\n", t, colon + 1); return -1; }
+        ws[nw].len = 0;
+        ws[nw].job = -1;
+        nw++;
+    }
+    return nw;
+}
+
+const char *dist_workers = NULL; /* --distribute host:porta,... */
+int dist_bench_workers = 0;      /* --dist-bench N: cria N trabalhadores locais e mede escala */
+const char *analysis_fen = NULL; /* --fen: posição analisada pelos modos em lote */
+#define DIST_BENCH_PORT 47100
+#define DEFAULT_ANALYSIS_FEN "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w - - 4 4"
+
+int run_distributed(void) {
+    Board bd;
+    int wt;
+    if (!parse_fen(analysis_fen ? analysis_fen : DEFAULT_ANALYSIS_FEN, &bd, &wt)) { fprintf(stderr, "FEN invalido\n"); return 1; }
+    DistWorker ws[MAX_THREADS];
+    int nw = dist_connect_list(dist_workers, ws, MAX_THREADS);
+    if (nw <= 0) return 1;
+    Move best;
+    int score;
+    long long nodes, t0 = now_ms();
+    if (!dist_search(ws, nw, &bd, wt, AI_DEPTH, &best, &score, &nodes)) { fprintf(stderr, "Trabalhador caiu\n"); return 1; }
+    char ms[8];
+    move_to_str(best, ms);
+    printf("bestmove %s score %d depth %d nodes %lld time %lld ms (%d trabalhadores)\n",
+           ms, score, AI_DEPTH, nodes, now_ms() - t0, nw);
+    for (int k=0;k<nw;k++) close(ws[k].fd);
+    return 0;
+}
+
+/* Sobe N trabalhadores locais e mede o tempo até a profundidade com 1..N deles */
+int run_dist_bench(void) {
+    Board bd;
+    int wt;
+    if (!parse_fen(analysis_fen ? analysis_fen : DEFAULT_ANALYSIS_FEN, &bd, &wt)) { fprintf(stderr, "FEN invalido\n"); return 1; }
+    int n = dist_bench_workers > MAX_THREADS ? MAX_THREADS : dist_bench_workers;
+    int spawned = n;
+    pid_t pids[MAX_THREADS];
+    for (int k=0;k<n;k++) {
+        char port[16];
+        snprintf(port, sizeof port, "%d", DIST_BENCH_PORT + k);
+        pids[k] = fork();
+        if (pids[k] == 0) {
+            execl("/proc/self/exe", "chess", "--server-tcp", port, "--threads", "1", "--hash", "64", (char *)NULL);
+            _exit(127);
+        }
+    }
+    DistWorker ws[MAX_THREADS];
+    for (int k=0;k<n;k++) {
+        ws[k].fd = dist_connect("127.0.0.1", DIST_BENCH_PORT + k);
+        ws[k].len = 0;
+        ws[k].job = -1;
+        if (ws[k].fd < 0) { fprintf(stderr, "Trabalhador %d nao respondeu\n", k); n = k; break; }
+    }
+    printf("profundidade %d\n%-14s %10s %10s %12s\n", AI_DEPTH, "trabalhadores", "tempo ms", "speedup", "nos");
+    long long base = 0;
+    for (int k=1;k<=n;k++) {
+        for (int j=0;j<k;j++) dist_request(&ws[j], "0 newgame\n"); /* hash frio para todas as medidas */
+        Move best;
+        int score;
+        long long nodes, t0 = now_ms();
+        if (!dist_search(ws, k, &bd, wt, AI_DEPTH, &best, &score, &nodes)) { fprintf(stderr, "Trabalhador caiu\n"); break; }
+        long long ms = now_ms() - t0;
+        if (k == 1) base = ms > 0 ? ms : 1;
+        printf("%-14d %10lld %10.2f %12lld\n", k, ms, (double)base / (ms > 0 ? ms : 1), nodes);
+    }
+    for (int k=0;k<n;k++) { dist_request(&ws[k], "0 shutdown\n"); close(ws[k].fd); }
+    /* os que não conectaram nunca recebem shutdown: sem o sinal, o waitpid esperaria para sempre */
+    for (int k=n;k<spawned;k++) if (pids[k] > 0) kill(pids[k], SIGTERM);
+    for (int k=0;k<spawned;k++) if (pids[k] > 0) waitpid(pids[k], NULL, 0);
+    return 0;
+}
+
+/* Zera hash, tabelas de ordenação e cache de resultados: cada busca parte do zero */
+void search_state_reset(void) {
+    tt_new_generation();
+    memset(result_cache, 0, sizeof result_cache);
+    for (int t=0;t<MAX_THREADS;t++) if (search_threads[t].local) memset(search_threads[t].local, 0, sizeof(ThreadTables));
+}
+
+/* Compara as duas raízes na mesma profundidade, posição a posição, com hash e tabelas de
+   ordenação zerados antes de cada busca e sem paradas antecipadas nem limites */
+const char *corpus_file = NULL; /* --corpus ARQUIVO: uma posição (FEN/EPD) por linha */
+static const char *default_corpus[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w - - 4 4",
+    "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - 0 1",
+    "5k2/6pp/p1qN4/1p1p4/3P4/2PKP2Q/PP3r2/3R4 b - - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+/* Posições de --corpus, ou as padrão; NULL se o arquivo não abre */
+char **corpus_load(int *n) {
+    *n = sizeof default_corpus / sizeof *default_corpus;
+    if (!corpus_file) return (char **)default_corpus;
+    BulkReader f;
+    const char *s;
+    size_t len;
+    char **fens = NULL;
+    int cap = 0;
+    if (!bulk_open(&f, corpus_file)) { fprintf(stderr, "Nao foi possivel abrir %s\n", corpus_file); return NULL; }
+    *n = 0;
+    while (bulk_next_line(&f, &s, &len)) {
+        if (!len || s[0] == '#') continue;
+        if (*n == cap) { cap = cap ? cap * 2 : 64; fens = realloc(fens, cap * sizeof *fens); }
+        fens[(*n)++] = strndup(s, len);
+    }
+    bulk_close(&f);
+    return fens;
+}
+
+int run_compare_mtdf(void) {
+    int n;
+    char **fens = corpus_load(&n);
+    if (!fens) return 1;
+    AI_THREADS = 1;
+    AI_TIME_MS = 0;
+    AI_NODES = 0;
+    AI_STABLE_ITERS = INT_MAX;
+    AI_RECAPTURE_MARGIN = INT_MAX;
+    printf("profundidade %d\n%-4s %9s %9s %12s %12s %9s %9s\n", AI_DEPTH, "pos", "score", "mtdf", "nos", "nos mtdf", "ms", "ms mtdf");
+    long long nodes[2] = {0, 0}, ms[2] = {0, 0};
+    int agree = 0, valid = 0;
+    for (int i=0;i<n;i++) {
+        Board bd;
+        int wt;
+        if (!parse_fen(fens[i], &bd, &wt)) { printf("%-4d FEN invalido\n", i + 1); continue; }
+        SearchInfo a, b;
+        search_state_reset();
+        search_position(&bd, wt, &a);
+        search_state_reset();
+        search_mtdf(&bd, wt, &b);
+        valid++;
+        agree += a.score == b.score;
+        nodes[0] += a.nodes; nodes[1] += b.nodes;
+        ms[0] += a.time_ms; ms[1] += b.time_ms;
+        printf("%-4d %9d %9d %12lld %12lld %9lld %9lld%s\n", i + 1, a.score, b.score, a.nodes, b.nodes,
+               a.time_ms, b.time_ms, a.score == b.score ? "" : "  (score difere)");
+        fflush(stdout);
+    }
+    printf("total%*s %12lld %12lld %9lld %9lld\n", 19, "", nodes[0], nodes[1], ms[0], ms[1]);
+    printf("MTD(f)/atual: nos %.2fx, tempo %.2fx; mesmo score em %d/%d\n",
+           nodes[0] ? (double)nodes[1] / nodes[0] : 0.0, ms[0] ? (double)ms[1] / ms[0] : 0.0, agree, valid);
+    return 0;
+}
+
+/* Treino da política a partir dos alvos gravados por --policy-data: softmax sobre as jogadas
+   quietas legais de cada amostra, SGD em ponto flutuante e quantização Q6 no fim. Um décimo
+   das amostras fica de fora para medir a taxa de acerto (float e já quantizada). */
+const char *policy_train_file = NULL; /* --policy-train ARQUIVO */
+const char *policy_out = NULL;        /* --policy-out ARQUIVO */
+int policy_epochs = 4;                /* --policy-epochs N */
+#define POLICY_LR 0.01f
+#define POLICY_W2_MAX (127.0f / (1 << POLICY_SHIFT))
+
+typedef struct {
+    float w1[POLICY_FEATURES][POLICY_HIDDEN];
+    float b1[POLICY_HIDDEN];
+    float w2[POLICY_MOVES][POLICY_HIDDEN];
+} PolicyTrainNet;
+
+static float policy_rand(unsigned long long *s) {
+    return (float)((splitmix64(s) >> 11) * (1.0 / 9007199254740992.0)) - 0.5f;
+}
+
+/* e^x para x <= 0 sem libm: 2^k pelos bits do expoente e série de Taylor no resto */
+static float policy_exp(float x) {
+    if (x < -80) return 0;
+    float t = x * 1.44269504f;
+    int k = (int)t;
+    if (t < k) k--;
+    float r = x - k * 0.69314718f, p = 1, term = 1;
+    for (int i=1;i<=7;i++) { term *= r / i; p += term; }
+    union { float f; unsigned u; } e = { .u = (unsigned)(k + 127) << 23 };
+    return p * e.f;
+}
+
+/* Logits das jogadas quietas da amostra; devolve quantas (ms/idx) e a posição do alvo em *target */
+static int policy_sample_moves(PolicySample *ps, Board *bd, Move *ms, int *idx, int *target) {
+    Move all[MAX_MOVES];
+    memcpy(bd->cell, ps->cell, 64);
+    bd->halfmove = 0;
+    int n = generate_legal_moves(bd, all, ps->white_turn), q = 0;
+    Move best = {ps->r1, ps->f1, ps->r2, ps->f2, ps->promotion};
+    *target = -1;
+    for (int i=0;i<n;i++) {
+        if (bd->cell[all[i].r2][all[i].f2] != '.') continue;
+        if (moves_equal(all[i], best)) *target = q;
+        ms[q] = all[i];
+        idx[q++] = policy_move_index(all[i], ps->white_turn);
+    }
+    return q;
+}
+
+/* Um passo de SGD (train) ou só avaliação; soma em *prob a probabilidade dada ao alvo e
+   devolve 1 se o maior logit é o alvo */
+static int policy_train_step(PolicyTrainNet *net, PolicySample *ps, int train, double *prob) {
+    Board bd;
+    Move ms[MAX_MOVES];
+    int idx[MAX_MOVES], feat[64], target;
+    int n = policy_sample_moves(ps, &bd, ms, idx, &target);
+    if (n < 2 || target < 0) return -1;
+    int nf = policy_features(&bd, ps->white_turn, feat);
+    float pre[POLICY_HIDDEN], h[POLICY_HIDDEN], logit[MAX_MOVES], dh[POLICY_HIDDEN] = {0};
+    for (int j=0;j<POLICY_HIDDEN;j++) {
+        pre[j] = net->b1[j];
+        for (int i=0;i<nf;i++) pre[j] += net->w1[feat[i]][j];
+        h[j] = pre[j] > 0 ? pre[j] : 0;
+    }
+    float mx = -1e30f, sum = 0;
+    int arg = 0;
+    for (int k=0;k<n;k++) {
+        float l = 0;
+        for (int j=0;j<POLICY_HIDDEN;j++) l += h[j] * net->w2[idx[k]][j];
+        logit[k] = l;
+        if (l > mx) { mx = l; arg = k; }
+    }
+    for (int k=0;k<n;k++) sum += logit[k] = policy_exp(logit[k] - mx);
+    *prob += logit[target] / sum;
+    if (train) {
+        for (int k=0;k<n;k++) {
+            float g = logit[k] / sum - (k == target);
+            float *w = net->w2[idx[k]];
+            for (int j=0;j<POLICY_HIDDEN;j++) {
+                dh[j] += g * w[j];
+                w[j] -= POLICY_LR * g * h[j];
+                w[j] = w[j] > POLICY_W2_MAX ? POLICY_W2_MAX : w[j] < -POLICY_W2_MAX ? -POLICY_W2_MAX : w[j];
+            }
+        }
+        for (int j=0;j<POLICY_HIDDEN;j++) {
+            if (pre[j] <= 0) continue;
+            net->b1[j] -= POLICY_LR * dh[j];
+            for (int i=0;i<nf;i++) net->w1[feat[i]][j] -= POLICY_LR * dh[j];
+        }
+    }
+    return arg == target;
+}
+
+static short policy_q16(float w) {
+    float q = w * (1 << POLICY_SHIFT);
+    q = (float)(int)(q + (q < 0 ? -0.5f : 0.5f));
+    return q > SHRT_MAX ? SHRT_MAX : q < SHRT_MIN ? SHRT_MIN : (short)q;
+}
+
+int run_policy_train(void) {
+    FILE *f = fopen(policy_train_file, "rb");
+    if (!f) { fprintf(stderr, "Nao foi possivel abrir %s\n", policy_train_file); return 1; }
+    if (!policy_out) { fprintf(stderr, "Informe --policy-out ARQUIVO\n"); fclose(f); return 1; }
+    struct stat sb;
+    fstat(fileno(f), &sb);
+    long long n = sb.st_size / sizeof(PolicySample);
+    PolicySample *data = malloc((n ? n : 1) * sizeof *data);
+    n = fread(data, sizeof *data, n, f);
+    fclose(f);
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    /* embaralha uma vez; as últimas n/10 amostras ficam para validação */
+    for (long long i=n-1;i>0;i--) {
+        long long j = splitmix64(&seed) % (i + 1);
+        PolicySample t = data[i]; data[i] = data[j]; data[j] = t;
+    }
+    long long ntrain = n - n / 10;
+    PolicyTrainNet *net = calloc(1, sizeof *net);
+    for (int i=0;i<POLICY_FEATURES;i++) for (int j=0;j<POLICY_HIDDEN;j++) net->w1[i][j] = 0.2f * policy_rand(&seed);
+    for (int j=0;j<POLICY_HIDDEN;j++) net->b1[j] = 0.1f;
+    for (int i=0;i<POLICY_MOVES;i++) for (int j=0;j<POLICY_HIDDEN;j++) net->w2[i][j] = 0.2f * policy_rand(&seed);
+    printf("%lld amostras (%lld treino, %lld validacao)\n", n, ntrain, n - ntrain);
+    for (int e=0;e<policy_epochs;e++) {
+        double prob = 0, vprob = 0;
+        long long hits = 0, cnt = 0, vhits = 0, vcnt = 0;
+        for (long long i=0;i<ntrain;i++) {
+            long long j = i + splitmix64(&seed) % (ntrain - i);
+            PolicySample t = data[i]; data[i] = data[j]; data[j] = t;
+            int r = policy_train_step(net, &data[i], 1, &prob);
+            if (r >= 0) { hits += r; cnt++; }
+        }
+        for (long long i=ntrain;i<n;i++) {
+            int r = policy_train_step(net, &data[i], 0, &vprob);
+            if (r >= 0) { vhits += r; vcnt++; }
+        }
+        printf("epoca %d: prob. do alvo %.3f acerto %.1f%% | validacao prob. %.3f acerto %.1f%%\n", e + 1,
+               cnt ? prob / cnt : 0.0, cnt ? 100.0 * hits / cnt : 0.0, vcnt ? vprob / vcnt : 0.0, vcnt ? 100.0 * vhits / vcnt : 0.0);
+        fflush(stdout);
+    }
+    PolicyNet *q = malloc(sizeof *q);
+    for (int i=0;i<POLICY_FEATURES;i++) for (int j=0;j<POLICY_HIDDEN;j++) q->w1[i][j] = policy_q16(net->w1[i][j]);
+    for (int j=0;j<POLICY_HIDDEN;j++) q->b1[j] = policy_q16(net->b1[j]);
+    for (int i=0;i<POLICY_MOVES;i++) for (int j=0;j<POLICY_HIDDEN;j++) q->w2[i][j] = (signed char)policy_q16(net->w2[i][j]);
+    /* acerto da rede quantizada, pelo mesmo caminho usado na busca */
+    free(policy_net);
+    policy_net = q;
+    long long qhits = 0, qcnt = 0;
+    for (long long i=ntrain;i<n;i++) {
+        Board bd;
+        Move ms[MAX_MOVES];
+        int idx[MAX_MOVES], target;
+        short h[POLICY_HIDDEN];
+        int m = policy_sample_moves(&data[i], &bd, ms, idx, &target);
+        if (m < 2 || target < 0) continue;
+        policy_hidden(&bd, data[i].white_turn, h);
+        int arg = 0, best = INT_MIN;
+        for (int k=0;k<m;k++) {
+            int l = policy_logit(h, ms[k], data[i].white_turn);
+            if (l > best) { best = l; arg = k; }
+        }
+        qhits += arg == target;
+        qcnt++;
+    }
+    printf("validacao quantizada: acerto %.1f%%\n", qcnt ? 100.0 * qhits / qcnt : 0.0);
+    FILE *o = fopen(policy_out, "wb");
+    if (!o || fwrite(POLICY_MAGIC, 1, 8, o) != 8 || fwrite(q, sizeof *q, 1, o) != 1) {
+        fprintf(stderr, "Nao foi possivel gravar %s\n", policy_out);
+        if (o) fclose(o);
+        return 1;
+    }
+    fclose(o);
+    printf("Pesos gravados em %s\n", policy_out);
+    free(net);
+    free(data);
+    return 0;
+}
+
+/* Anotação de partida inteira: reproduz a lista de lances com apply_move e analisa as
+   posições da última para a primeira, sem limpar hash, killers e histórico entre elas; a
+   análise da posição seguinte já aquecida vale como avaliação do lance jogado. Em seguida
+   repete as mesmas buscas de forma independente (tudo zerado) para medir o ganho. */
+const char *annotate_file = NULL; /* --annotate ARQUIVO (lances em SAN ou coordenadas; --fen dá a posição inicial) */
+#define ANNOTATE_MAX_PLIES 1024
+#define BLUNDER_CP 200
+#define MISTAKE_CP 100
+
+void score_to_str(int score, char *out) {
+    if (score >= 1000000 - MAX_PLY) sprintf(out, "#+");
+    else if (score <= -1000000 + MAX_PLY) sprintf(out, "#-");
+    else sprintf(out, "%+.2f", score / 100.0);
+}
+
+int run_annotate(void) {
+    static Board pos[ANNOTATE_MAX_PLIES + 1];
+    static Move played[ANNOTATE_MAX_PLIES];
+    static SearchInfo info[ANNOTATE_MAX_PLIES + 1];
+    int side[ANNOTATE_MAX_PLIES + 1];
+    PgnReader f;
+    if (!pgn_open(&f, annotate_file)) { fprintf(stderr, "Nao foi possivel abrir %s\n", annotate_file); return 1; }
+    if (analysis_fen) {
+        if (!parse_fen(analysis_fen, &pos[0], &side[0])) { fprintf(stderr, "FEN invalido\n"); pgn_close(&f); return 1; }
+    } else {
+        init_board(&pos[0]);
+        side[0] = 1;
+    }
+    int n = 0;
+    char tok[64];
+    int game_end;
+    while (n < ANNOTATE_MAX_PLIES && pgn_next_token(&f, tok, sizeof tok, &game_end)) {
+        if (game_end) continue;
+        Move legal[MAX_MOVES];
+        int nl = generate_legal_moves(&pos[n], legal, side[n]), found = -1;
+        for (int i=0;i<nl && found < 0;i++) if (move_matches_text(&pos[n], side[n], legal[i], tok)) found = i;
+        if (found < 0) { fprintf(stderr, "Lance %d invalido: %s\n", n + 1, tok); pgn_close(&f); return 1; }
+        played[n] = legal[found];
+        copy_board(&pos[n+1], &pos[n]);
+        apply_move(&pos[n+1], played[n]);
+        side[n+1] = !side[n];
+        n++;
+    }
+    pgn_close(&f);
+    if (n == 0) { fprintf(stderr, "Nenhum lance\n"); return 1; }
+
+    /* todas as posições até a mesma profundidade: sem paradas antecipadas, sem cache de
+       resultados e buscando também as respostas forçadas, que valem como qualquer lance */
+    AI_STABLE_ITERS = INT_MAX;
+    AI_RECAPTURE_MARGIN = INT_MAX;
+    search_full = 1;
+
+    /* passada aquecida, de trás para frente (inclui a posição final) */
+    long long warm_ms = 0, warm_nodes = 0, cold_ms = 0, cold_nodes = 0;
+    search_state_reset();
+    for (int k=n; k>=0; k--) {
+        Move legal[MAX_MOVES];
+        if (generate_legal_moves(&pos[k], legal, side[k]) == 0) { /* fim de jogo: mate ou afogamento */
+            memset(&info[k], 0, sizeof info[k]);
+            info[k].score = is_in_check(&pos[k], side[k]) ? (side[k] ? -1000000 : 1000000) : 0;
+            continue;
+        }
+        search_position(&pos[k], side[k], &info[k]);
+        warm_ms += info[k].time_ms;
+        warm_nodes += info[k].nodes;
+    }
+
+    printf("Analise (prof %d, tempo %d ms por posicao):\n", AI_DEPTH, AI_TIME_MS);
+    int blunders[2] = {0, 0}, mistakes[2] = {0, 0};
+    for (int k=0;k<n;k++) {
+        char san[16], best_san[16], sc[16], best_sc[16];
+        move_to_san(&pos[k], side[k], played[k], san);
+        move_to_san(&pos[k], side[k], info[k].best, best_san);
+        int same = moves_equal(played[k], info[k].best);
+        int score = same ? info[k].score : info[k+1].score; /* o lance jogado vale a análise da posição seguinte */
+        long long loss = side[k] ? (long long)info[k].score - score : (long long)score - info[k].score;
+        if (loss < 0) loss = 0;
+        const char *flag = loss >= BLUNDER_CP ? "??" : loss >= MISTAKE_CP ? "?" : "";
+        if (loss >= BLUNDER_CP) blunders[side[k]]++;
+        else if (loss >= MISTAKE_CP) mistakes[side[k]]++;
+        score_to_str(score, sc);
+        score_to_str(info[k].score, best_sc);
+        char num[16];
+        snprintf(num, sizeof num, side[k] ? "%d." : "%d...", k / 2 + 1);
+        if (same) printf("%7s %-8s %7s  (melhor)\n", num, san, sc);
+        else if (loss && (abs(score) >= 1000000 - MAX_PLY || abs(info[k].score) >= 1000000 - MAX_PLY))
+            printf("%7s %-8s %7s  melhor %-8s %7s  %s %s\n", num, san, sc, best_san, best_sc,
+                   abs(score) >= 1000000 - MAX_PLY ? "leva mate" : "deixa escapar o mate", flag);
+        else printf("%7s %-8s %7s  melhor %-8s %7s  perda %lld%s%s\n", num, san, sc, best_san, best_sc,
+                    loss, *flag ? " " : "", flag);
+    }
+    printf("Brancas: %d erro(s) grave(s), %d imprecisao(oes); Pretas: %d erro(s) grave(s), %d imprecisao(oes)\n",
+           blunders[1], mistakes[1], blunders[0], mistakes[0]);
+
+    /* mesmas buscas, cada uma do zero e em ordem direta, para comparação */
+    for (int k=0;k<=n;k++) {
+        Move legal[MAX_MOVES];
+        if (generate_legal_moves(&pos[k], legal, side[k]) == 0) continue;
+        SearchInfo cold;
+        search_state_reset();
+        search_position(&pos[k], side[k], &cold);
+        cold_ms += cold.time_ms;
+        cold_nodes += cold.nodes;
+    }
+    printf("Reaproveitando o estado: %lld ms, %lld nos; independentes: %lld ms, %lld nos; ganho %.2fx em tempo, %.2fx em nos\n",
+           warm_ms, warm_nodes, cold_ms, cold_nodes,
+           warm_ms ? (double)cold_ms / warm_ms : 0.0, warm_nodes ? (double)cold_nodes / warm_nodes : 0.0);
+    return 0;
+}
+
+/* Recursos visíveis ao processo. Num contêiner o sistema mostra todas as CPUs e toda a
+   memória do host; os limites reais estão no cgroup (v2: cpu.max e memory.max ao longo da
+   hierarquia; v1: cfs_quota/cfs_period e memory.limit_in_bytes) e na máscara de afinidade. */
+typedef struct {
+    int affinity_cpus;     /* CPUs na máscara de afinidade */
+    double quota_cpus;     /* cota de CPU do cgroup (0 = sem cota) */
+    long long mem_limit;   /* bytes (0 = sem limite no cgroup) */
+    long long mem_total;   /* memória física do host */
+} Resources;
+
+/* Lê até dois inteiros de um arquivo de controle; "max" vale -1. Retorna quantos leu. */
+int read_control_file(const char *path, long long *a, long long *b) {
+    char buf[128];
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    int n = 0;
+    if (fgets(buf, sizeof buf, fp)) {
+        char *p = buf, *end;
+        for (; n < 2; n++) {
+            while (*p == ' ') p++;
+            long long v;
+            if (!strncmp(p, "max", 3)) { v = -1; end = p + 3; }
+            else { v = strtoll(p, &end, 10); if (end == p) break; }
+            if (n == 0) *a = v; else *b = v;
+            p = end;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+/* Caminho do processo na hierarquia do cgroup ("0::/caminho" em v2, "ctrl:/caminho" em v1) */
+int cgroup_path(const char *controller, char *out, size_t outsz) {
+    char line[512];
+    FILE *fp = fopen("/proc/self/cgroup", "r");
+    if (!fp) return 0;
+    int found = 0;
+    while (!found && fgets(line, sizeof line, fp)) {
+        char *c1 = strchr(line, ':');
+        char *c2 = c1 ? strchr(c1 + 1, ':') : NULL;
+        if (!c2) continue;
+        *c2 = '\0';
+        if (strcmp(c1 + 1, controller) && !(controller[0] == '\0' && c1[1] == '\0')) continue;
+        char *path = c2 + 1;
+        path[strcspn(path, "\n")] = '\0';
+        snprintf(out, outsz, "%s", path);
+        found = 1;
+    }
+    fclose(fp);
+    return found;
+}
+
+/* Arquivo de um controlador v1: no caminho do processo ou, se o contêiner só enxerga a
+   própria hierarquia montada, na raiz do controlador */
+int read_cgroup_v1(const char *controller, const char *name, long long *v) {
+    char rel[384], file[600];
+    long long unused;
+    if (cgroup_path(controller, rel, sizeof rel) && strcmp(rel, "/")) {
+        snprintf(file, sizeof file, "/sys/fs/cgroup/%s%s/%s", controller, rel, name);
+        if (read_control_file(file, v, &unused) >= 1) return 1;
+    }
+    snprintf(file, sizeof file, "/sys/fs/cgroup/%s/%s", controller, name);
+    return read_control_file(file, v, &unused) >= 1;
+}
+
+void detect_resources(Resources *rs) {
+    memset(rs, 0, sizeof *rs);
+    cpu_set_t set;
+    rs->affinity_cpus = sched_getaffinity(0, sizeof set, &set) == 0 ? CPU_COUNT(&set) : 0;
+    if (rs->affinity_cpus <= 0) rs->affinity_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    rs->mem_total = (long long)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+
+    char rel[384], dir[512], file[600];
+    long long a, b;
+    if (cgroup_path("", rel, sizeof rel)) {
+        /* v2: o limite efetivo é o menor ao longo do caminho até a raiz montada */
+        snprintf(dir, sizeof dir, "/sys/fs/cgroup%s", strcmp(rel, "/") ? rel : "");
+        for (;;) {
+            snprintf(file, sizeof file, "%s/cpu.max", dir);
+            if (read_control_file(file, &a, &b) == 2 && a > 0 && b > 0) {
+                double q = (double)a / b;
+                if (rs->quota_cpus == 0 || q < rs->quota_cpus) rs->quota_cpus = q;
+            }
+            snprintf(file, sizeof file, "%s/memory.max", dir);
+            if (read_control_file(file, &a, &b) >= 1 && a > 0 && (rs->mem_limit == 0 || a < rs->mem_limit)) rs->mem_limit = a;
+            char *slash = strrchr(dir, '/');
+            if (!slash || slash - dir <= (long)strlen("/sys/fs/cgroup")) break;
+            *slash = '\0';
+        }
+    }
+    if (rs->quota_cpus == 0 && read_cgroup_v1("cpu", "cpu.cfs_quota_us", &a) && a > 0 &&
+        read_cgroup_v1("cpu", "cpu.cfs_period_us", &b) && b > 0) rs->quota_cpus = (double)a / b;
+    /* v1 usa um número enorme (próximo de 2^63) para "sem limite" */
+    if (rs->mem_limit == 0 && read_cgroup_v1("memory", "memory.limit_in_bytes", &a) && a > 0 && a < rs->mem_total)
+        rs->mem_limit = a;
+}
+
+/* Ajusta threads e hash aos limites do contêiner quando não vieram na linha de comando:
+   threads = CPUs utilizáveis (cota arredondada para cima, limitada pela afinidade);
+   hash = a maior potência de 2 que caiba em 1/4 da memória permitida, até HASH_AUTO_MAX_MB */
+#define HASH_AUTO_MAX_MB 256
+int opt_threads_set = 0, opt_hash_set = 0;
+
+void apply_resource_defaults(void) {
+    Resources rs;
+    detect_resources(&rs);
+    int cpus = rs.affinity_cpus;
+    if (rs.quota_cpus > 0) {
+        int q = (int)rs.quota_cpus;
+        if (q < rs.quota_cpus) q++;
+        if (q < cpus) cpus = q;
+    }
+    if (cpus < 1) cpus = 1;
+    if (cpus > MAX_THREADS) cpus = MAX_THREADS;
+    long long mem = rs.mem_limit > 0 ? rs.mem_limit : rs.mem_total;
+    int hash = 1;
+    while (hash * 2 <= HASH_AUTO_MAX_MB && ((long long)hash * 2 << 20) <= mem / 4) hash *= 2;
+    if (!opt_threads_set) AI_THREADS = cpus;
+    if (!opt_hash_set) AI_HASH_MB = hash;
+    if (!strcmp(run_mode, "epd-worker")) return; /* o pai já informou */
+    fprintf(stderr, "Recursos: afinidade %d CPUs, cota ", rs.affinity_cpus);
+    if (rs.quota_cpus > 0) fprintf(stderr, "%.2f CPUs", rs.quota_cpus); else fprintf(stderr, "nenhuma");
+    fprintf(stderr, ", memoria %lld MB%s -> threads %d%s, hash %d MB%s\n",
+            mem >> 20, rs.mem_limit > 0 ? " (cgroup)" : " (host)",
+            AI_THREADS, opt_threads_set ? " (opcao)" : "", AI_HASH_MB, opt_hash_set ? " (opcao)" : "");
+}
+
+/* Suíte tática em EPD: cada linha traz uma posição e as operações bm (melhor jogada) e/ou am
+   (jogada a evitar). As posições são buscadas em processos filhos, que pegam a próxima linha
+   de um contador compartilhado e devolvem uma linha de resultado por um pipe comum (linhas
+   curtas, escritas atomicamente). Os filhos são o próprio executável de novo (exec, como os
+   trabalhadores de --dist-bench), com as mesmas opções mais --epd-worker: um fork sem exec
+   herdaria travas presas por threads do pai (gravador de voo, métricas) que não existem no
+   filho. Uma posição conta como resolvida se a jogada final estiver certa; o tempo de
+   solução é o da primeira iteração a partir da qual a jogada ficou certa. */
+const char *epd_file = NULL; /* --epd ARQUIVO */
+int epd_jobs = 0;            /* --epd-jobs N; 0 = uma por thread disponível */
+int epd_counter_fd = -1, epd_out_fd = -1; /* --epd-worker CONTADOR:SAIDA (uso interno) */
+int prog_argc = 0;
+char **prog_argv = NULL;     /* linha de comando original, repassada aos filhos */
+int opt_depth_set = 0;
+
+/* Extrai o valor de uma operação EPD ("bm Nf3 Qd1;"), sem aspas; 0 se ausente */
+int epd_opcode(const char *ops, const char *name, char *out, size_t sz) {
+    size_t nl = strlen(name);
+    for (const char *p = ops; *p; ) {
+        while (*p == ' ' || *p == ';' || *p == '\t') p++;
+        const char *end = strchr(p, ';');
+        if (!end) end = p + strlen(p);
+        if (!strncmp(p, name, nl) && p[nl] == ' ') {
+            const char *v = p + nl + 1;
+            size_t k = 0;
+            for (; v < end && k + 1 < sz; v++) if (*v != '"') out[k++] = *v;
+            while (k && isspace((unsigned char)out[k-1])) k--;
+            out[k] = '\0';
+            return 1;
+        }
+        p = end;
+    }
+    return 0;
+}
+
+/* Jogada certa: está entre as bm (se houver) e não está entre as am */
+int epd_correct(Board *bd, int white_turn, Move m, const char *bm, const char *am) {
+    char list[256], *save = NULL;
+    if (*bm) {
+        int hit = 0;
+        snprintf(list, sizeof list, "%s", bm);
+        for (char *t = strtok_r(list, " ", &save); t; t = strtok_r(NULL, " ", &save))
+            if (move_matches_text(bd, white_turn, m, t)) hit = 1;
+        if (!hit) return 0;
+    }
+    if (*am) {
+        snprintf(list, sizeof list, "%s", am);
+        for (char *t = strtok_r(list, " ", &save); t; t = strtok_r(NULL, " ", &save))
+            if (move_matches_text(bd, white_turn, m, t)) return 0;
+    }
+    return 1;
+}
+
+/* Busca uma posição da suíte e escreve "idx status prof ms nos tempo_total jogada id" */
+void epd_solve(int idx, const char *line, int out_fd) {
+    char res[512], id[64] = "", bm[256] = "", am[256] = "";
+    const char *ops = line;
+    for (int field=0; field<4 && *ops; field++) { /* EPD: 4 campos de posição, depois operações */
+        while (*ops == ' ') ops++;
+        while (*ops && *ops != ' ') ops++;
+    }
+    Board bd;
+    int wt;
+    epd_opcode(ops, "id", id, sizeof id);
+    epd_opcode(ops, "bm", bm, sizeof bm);
+    epd_opcode(ops, "am", am, sizeof am);
+    if (!parse_fen(line, &bd, &wt) || (!*bm && !*am)) {
+        snprintf(res, sizeof res, "%d invalida 0 0 0 0 - %s\n", idx, *id ? id : "-");
+    } else {
+        tt_new_generation(); /* cada posição começa com hash vazio: medidas independentes */
+        SearchInfo info;
+        Move best = search_position(&bd, wt, &info);
+        Move legal[MAX_MOVES];
+        char san[16] = "-";
+        int nlegal = generate_legal_moves(&bd, legal, wt);
+        if (nlegal) move_to_san(&bd, wt, best, san);
+        int ok = nlegal > 0 && epd_correct(&bd, wt, best, bm, am);
+        /* primeira iteração a partir da qual todas as seguintes acertaram */
+        int first = info.iters;
+        while (first > 0 && epd_correct(&bd, wt, info.iter_best[first-1], bm, am)) first--;
+        int found_depth = ok ? (first < info.iters ? first + 1 : info.depth) : 0;
+        long long found_ms = ok && first < info.iters ? info.iter_ms[first] : 0;
+        snprintf(res, sizeof res, "%d %s %d %lld %lld %lld %s %s\n", idx, ok ? "ok" : "falhou",
+                 found_depth, found_ms, info.nodes, info.time_ms, san, *id ? id : "-");
+    }
+    size_t len = strlen(res), off = 0;
+    while (off < len) {
+        ssize_t w = write(out_fd, res + off, len - off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+}
+
+int cmp_long_long(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Linhas não vazias da suíte (sem comentários); NULL se o arquivo não abre ou está vazio */
+char **epd_load(int *n) {
+    BulkReader f;
+    if (!bulk_open(&f, epd_file)) { fprintf(stderr, "Nao foi possivel abrir %s\n", epd_file); return NULL; }
+    char **lines = NULL;
+    const char *s;
+    size_t len;
+    int cap = 0;
+    *n = 0;
+    while (bulk_next_line(&f, &s, &len)) {
+        while (len && isspace((unsigned char)*s)) { s++; len--; }
+        if (!len || *s == '#') continue;
+        if (*n == cap) { cap = cap ? cap * 2 : 64; lines = realloc(lines, cap * sizeof *lines); }
+        lines[(*n)++] = strndup(s, len);
+    }
+    bulk_close(&f);
+    if (*n == 0) { fprintf(stderr, "Suite vazia\n"); return NULL; }
+    return lines;
+}
+
+/* Paralelismo entre posições: um processo por thread disponível, cada um com 1 thread e
+   uma fatia do hash, salvo se --threads/--hash foram dados. Pai e filhos chegam aos mesmos
+   valores a partir das mesmas opções. Retorna o número de processos. */
+int epd_configure(int n) {
+    int jobs = epd_jobs > 0 ? epd_jobs : (opt_threads_set ? 1 : AI_THREADS);
+    if (jobs > n) jobs = n;
+    if (jobs < 1) jobs = 1;
+    if (!opt_threads_set) AI_THREADS = 1;
+    if (!opt_hash_set) AI_HASH_MB = AI_HASH_MB / jobs > 0 ? AI_HASH_MB / jobs : 1;
+    /* a busca vai até o limite de tempo/nós, sem as paradas antecipadas */
+    if (!opt_depth_set) AI_DEPTH = MAX_PLY - 1;
+    AI_STABLE_ITERS = INT_MAX;
+    AI_RECAPTURE_MARGIN = INT_MAX;
+    return jobs;
+}
+
+/* Processo filho da suíte: pega índices do contador compartilhado e escreve os resultados */
+int run_epd_worker(void) {
+    int n;
+    char **lines = epd_load(&n);
+    if (!lines) return 1;
+    epd_configure(n);
+    tt_resize(AI_HASH_MB);
+    atomic_int *next = mmap(NULL, sizeof(atomic_int), PROT_READ | PROT_WRITE, MAP_SHARED, epd_counter_fd, 0);
+    if (next == MAP_FAILED) { perror("epd"); return 1; }
+    int i;
+    while ((i = atomic_fetch_add(next, 1)) < n) epd_solve(i, lines[i], epd_out_fd);
+    return 0;
+}
+
+int run_epd(void) {
+    int n;
+    char **lines = epd_load(&n);
+    if (!lines) return 1;
+    int jobs = epd_configure(n);
+    printf("Suite %s: %d posicoes, %d processo(s) x %d thread(s), tempo %d ms, nos %lld, prof %d\n",
+           epd_file, n, jobs, AI_THREADS, AI_TIME_MS, AI_NODES, AI_DEPTH);
+    fflush(stdout);
+
+    /* contador num arquivo temporário mapeado por todos: sobrevive ao exec dos filhos */
+    FILE *counter = tmpfile();
+    int fds[2];
+    if (!counter || ftruncate(fileno(counter), sizeof(atomic_int)) < 0 || pipe(fds) < 0) { perror("epd"); return 1; }
+    atomic_int *next = mmap(NULL, sizeof(atomic_int), PROT_READ | PROT_WRITE, MAP_SHARED, fileno(counter), 0);
+    if (next == MAP_FAILED) { perror("epd"); return 1; }
+    atomic_init(next, 0);
+    /* argv dos filhos montado antes do fork: entre fork e exec só chamadas seguras */
+    char fdarg[32];
+    snprintf(fdarg, sizeof fdarg, "%d:%d", fileno(counter), fds[1]);
+    char **args = calloc(prog_argc + 3, sizeof *args);
+    for (int k=0;k<prog_argc;k++) args[k] = prog_argv[k];
+    args[prog_argc] = "--epd-worker";
+    args[prog_argc + 1] = fdarg;
+    long long t0 = now_ms();
+    for (int j=0;j<jobs;j++) {
+        pid_t pid = fork();
+        if (pid < 0) { perror("fork"); jobs = j; break; }
+        if (pid == 0) {
+            close(fds[0]);
+            execv("/proc/self/exe", args);
+            _exit(127);
+        }
+    }
+    free(args);
+    close(fds[1]);
+
+    FILE *in = fdopen(fds[0], "r");
+    long long *solve_ms = calloc(n, sizeof *solve_ms), total_nodes = 0;
+    int solved = 0, invalid = 0, got = 0;
+    long long depth_sum = 0;
+    char line[512];
+    while (in && fgets(line, sizeof line, in)) {
+        int idx, depth;
+        long long ms, nodes, total_ms;
+        char status[16], san[16], id[64];
+        if (sscanf(line, "%d %15s %d %lld %lld %lld %15s %63[^\n]", &idx, status, &depth, &ms, &nodes, &total_ms, san, id) != 8) continue;
+        got++;
+        total_nodes += nodes;
+        if (!strcmp(status, "invalida")) invalid++;
+        if (!strcmp(status, "ok")) { solve_ms[solved++] = ms; depth_sum += depth; }
+        if (!strcmp(status, "ok")) printf("[%d/%d] %-16s ok      %-7s prof %2d  %6lld ms\n", got, n, id, san, depth, ms);
+        else printf("[%d/%d] %-16s %-7s %-7s (%lld ms, %lld nos)\n", got, n, id, status, san, total_ms, nodes);
+        fflush(stdout);
+    }
+    if (in) fclose(in);
+    while (wait(NULL) > 0) {}
+    munmap(next, sizeof(atomic_int));
+    fclose(counter);
+    long long elapsed = now_ms() - t0;
+
+    qsort(solve_ms, solved, sizeof *solve_ms, cmp_long_long);
+    printf("\nResolvidas: %d/%d (%.1f%%)", solved, n - invalid, n > invalid ? 100.0 * solved / (n - invalid) : 0.0);
+    if (invalid) printf(", %d invalida(s)", invalid);
+    printf("  tempo total %lld ms, %lld nos\n", elapsed, total_nodes);
+    if (solved) {
+        printf("Tempo ate a solucao: mediana %lld ms, p90 %lld ms, max %lld ms, prof media %.1f\n",
+               solve_ms[(solved - 1) / 2], solve_ms[(int)(0.9 * (solved - 1))], solve_ms[solved - 1], (double)depth_sum / solved);
+        const long long bounds[] = {10, 100, 1000, 10000};
+        int b = 0, acc = 0;
+        for (int k=0;k<4;k++) {
+            while (b < solved && solve_ms[b] <= bounds[k]) b++;
+            printf("  <= %5lld ms: %4d (%d acumuladas)\n", bounds[k], b - acc, b);
+            acc = b;
+        }
+        printf("  >  %5lld ms: %4d\n", bounds[3], solved - acc);
+    }
+    free(solve_ms);
+    return 0;
+}
+
+/* Mineração de problemas táticos em arquivos de partidas, em três estágios ligados por filas
+   limitadas (o leitor espera quando o filtro atrasa, e assim por diante):
+     leitor (thread principal): reproduz as partidas e enfileira cada posição;
+     filtro (pool): busca rasa de todas as jogadas da raiz e guarda só as posições em que
+       uma jogada ganha e se destaca das demais sem que o material já mostre o ganho;
+     verificação (pool): repete na profundidade cheia e confirma que a jogada vencedora é
+       única; grava "FEN;jogada;score;margem;linha;partida:lance" no arquivo de saída.
+   search_position não é reentrante (threads e pool globais), então cada worker tem a sua
+   SearchThread e chama minimax direto na raiz, com janela cheia por jogada como a
+   choose_ai_move; o hash é compartilhado por todos. */
+const char *mine_file = NULL, *mine_out = NULL; /* --mine ARQUIVO --mine-out SAIDA */
+int mine_filter_depth = 2;      /* --mine-filter-depth N */
+int mine_filter_threads = 0;    /* --mine-filter-threads N; 0 = metade das threads */
+int mine_verify_threads = 0;    /* --mine-verify-threads N; 0 = metade das threads */
+#define MINE_QUEUE_CAP 1024
+#define MINE_MIN_PLY 8          /* aberturas não rendem problemas e se repetem entre partidas */
+#define MINE_WIN_CP 200         /* vantagem mínima depois da jogada certa */
+#define MINE_GAP_CP 150         /* distância mínima para a segunda melhor e para a avaliação estática */
+#define MINE_PV_MAX 8
+
+typedef struct {
+    Board bd;
+    int white_turn;
+    long long game;
+    int ply;
+} MinePos;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+    MinePos items[MINE_QUEUE_CAP];
+    int head, count;
+    int producers; /* produtores ainda ativos; sem nenhum e vazia, a fila terminou */
+} MineQueue;
+
+void mq_init(MineQueue *q, int producers) {
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    q->head = q->count = 0;
+    q->producers = producers;
+}
+
+void mq_push(MineQueue *q, const MinePos *p) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == MINE_QUEUE_CAP) pthread_cond_wait(&q->not_full, &q->lock);
+    q->items[(q->head + q->count) % MINE_QUEUE_CAP] = *p;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Retira um item; 0 quando a fila terminou */
+int mq_pop(MineQueue *q, MinePos *p) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && q->producers > 0) pthread_cond_wait(&q->not_empty, &q->lock);
+    int ok = q->count > 0;
+    if (ok) {
+        *p = q->items[q->head];
+        q->head = (q->head + 1) % MINE_QUEUE_CAP;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+void mq_producer_done(MineQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->producers--;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+typedef struct {
+    MineQueue positions, candidates;
+    FILE *out;
+    pthread_mutex_t out_lock;
+    atomic_llong games, positions_seen, filtered, puzzles;
+    /* problemas já gravados (hash canônico): endereçamento aberto que guarda todas as chaves,
+       dobrado a meia carga; 0 marca casa vazia, então a chave 0 tem um indicador à parte */
+    unsigned long long *seen;
+    size_t seen_cap, seen_n;
+    int seen_zero;
+} Miner;
+
+Miner miner;
+
+/* Registra a chave; 1 se ainda não tinha sido gravada. Chamada com out_lock. */
+int mine_seen_insert(unsigned long long key) {
+    if (!key) { int fresh = !miner.seen_zero; miner.seen_zero = 1; return fresh; }
+    if (2 * (miner.seen_n + 1) > miner.seen_cap) {
+        size_t cap = miner.seen_cap ? miner.seen_cap * 2 : 1024;
+        unsigned long long *t = calloc(cap, sizeof *t);
+        if (!t) return 1; /* sem memória: grava mesmo que repita */
+        for (size_t i=0;i<miner.seen_cap;i++) {
+            unsigned long long k = miner.seen[i];
+            if (!k) continue;
+            size_t j = k & (cap - 1);
+            while (t[j]) j = (j + 1) & (cap - 1);
+            t[j] = k;
+        }
+        free(miner.seen);
+        miner.seen = t;
+        miner.seen_cap = cap;
+    }
+    size_t j = key & (miner.seen_cap - 1);
+    for (; miner.seen[j]; j = (j + 1) & (miner.seen_cap - 1)) if (miner.seen[j] == key) return 0;
+    miner.seen[j] = key;
+    miner.seen_n++;
+    return 1;
+}
+
+/* Scores de todas as jogadas da raiz em janela cheia (MultiPV completo) */
+int mine_root_scores(SearchThread *st, Board *bd, int white_turn, int depth, Move *moves, int *scores) {
+    int n = generate_legal_moves(bd, moves, white_turn);
+    Board tmp;
+    for (int i=0;i<n;i++) {
+        copy_board(&tmp, bd);
+        apply_move(&tmp, moves[i]);
+        scores[i] = minimax(st, &tmp, depth-1, INT_MIN/2, INT_MAX/2, !white_turn);
+    }
+    return n;
+}
+
+/* Jogada vencedora única: índice da melhor ou -1; scores e margem do ponto de vista de quem joga */
+int mine_unique_win(Board *bd, int white_turn, int n, int *scores, int *best_score, int *gap) {
+    if (n < 2) return -1;
+    int sign = white_turn ? 1 : -1, second;
+    int bi = pick_root_best(scores, n, white_turn, &second);
+    int b = sign * scores[bi], s = sign * second, stat = sign * evaluate_board(bd);
+    *best_score = b;
+    *gap = b - s;
+    if (b < MINE_WIN_CP || b - s < MINE_GAP_CP || b - stat < MINE_GAP_CP) return -1;
+    return bi;
+}
+
+void mine_thread_init(SearchThread *st, int id) {
+    memset(st, 0, sizeof *st);
+    st->id = id;
+    st->node = id % numa_nodes;
+    st->tt = tt_table;
+    st->tt_mask = tt_entries - 1;
+    search_thread_enter(st);
+}
+
+void *mine_filter_main(void *arg) {
+    SearchThread st;
+    mine_thread_init(&st, (int)(long)arg);
+    MinePos p;
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES], best, gap;
+    while (mq_pop(&miner.positions, &p)) {
+        if (!dedup_position(&p.bd, p.white_turn)) continue;
+        int n = mine_root_scores(&st, &p.bd, p.white_turn, mine_filter_depth, moves, scores);
+        if (mine_unique_win(&p.bd, p.white_turn, n, scores, &best, &gap) >= 0) {
+            atomic_fetch_add(&miner.filtered, 1);
+            mq_push(&miner.candidates, &p);
+        }
+    }
+    mq_producer_done(&miner.candidates);
+    free(st.local);
+    free(st.mc);
+    return NULL;
+}
+
+void *mine_verify_main(void *arg) {
+    SearchThread st;
+    mine_thread_init(&st, (int)(long)arg);
+    MinePos p;
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES], best, gap;
+    while (mq_pop(&miner.candidates, &p)) {
+        int n = mine_root_scores(&st, &p.bd, p.white_turn, AI_DEPTH, moves, scores);
+        int bi = mine_unique_win(&p.bd, p.white_turn, n, scores, &best, &gap);
+        if (bi < 0) continue;
+        int sym;
+        unsigned long long key = canonical_hash(&p.bd, p.white_turn, &sym);
+        /* linha principal pelo hash, a partir da jogada vencedora */
+        char line[256] = "", fen[128], ms[8];
+        Board b;
+        copy_board(&b, &p.bd);
+        Move m = moves[bi];
+        int side = p.white_turn, len = 0;
+        for (int k=0; k<MINE_PV_MAX; k++) {
+            move_to_str(m, ms);
+            len += snprintf(line + len, sizeof line - len, "%s%s", k ? " " : "", ms);
+            apply_move(&b, m);
+            side = !side;
+            int s, d, f;
+            Move next, legal;
+            if (!tt_probe(&st, board_hash(&b, side), &s, &d, &f, &next) || !find_legal_move(&b, side, next, &legal)) break;
+            m = legal;
+        }
+        board_to_fen(&p.bd, p.white_turn, fen);
+        move_to_str(moves[bi], ms);
+        pthread_mutex_lock(&miner.out_lock);
+        if (mine_seen_insert(key)) {
+            fprintf(miner.out, "%s;%s;%+d;%d;%s;%lld:%d\n", fen, ms, best, gap, line, p.game, p.ply);
+            atomic_fetch_add(&miner.puzzles, 1);
+        }
+        pthread_mutex_unlock(&miner.out_lock);
+    }
+    free(st.local);
+    free(st.mc);
+    return NULL;
+}
+
+int run_mine(void) {
+    PgnReader in;
+    if (!pgn_open(&in, mine_file)) { fprintf(stderr, "Nao foi possivel abrir %s\n", mine_file); return 1; }
+    miner.out = fopen(mine_out ? mine_out : "puzzles.txt", "w");
+    if (!miner.out) { fprintf(stderr, "Nao foi possivel criar a saida\n"); pgn_close(&in); return 1; }
+    if (!opt_depth_set) AI_DEPTH = 5;
+    int nf = mine_filter_threads > 0 ? mine_filter_threads : (AI_THREADS / 2 > 0 ? AI_THREADS / 2 : 1);
+    int nv = mine_verify_threads > 0 ? mine_verify_threads : (AI_THREADS - nf > 0 ? AI_THREADS - nf : 1);
+    if (nf > MAX_THREADS) nf = MAX_THREADS;
+    if (nv > MAX_THREADS) nv = MAX_THREADS;
+    if (!numa_nodes) numa_detect();
+    tt_clear(); /* as threads da mineração usam o hash direto, sem search_start_task para zerá-lo */
+    pthread_mutex_init(&miner.out_lock, NULL);
+    mq_init(&miner.positions, 1);
+    mq_init(&miner.candidates, nf);
+    pthread_t tids[2 * MAX_THREADS];
+    for (int t=0;t<nf;t++) pthread_create(&tids[t], NULL, mine_filter_main, (void *)(long)t);
+    for (int t=0;t<nv;t++) pthread_create(&tids[nf + t], NULL, mine_verify_main, (void *)(long)(nf + t));
+    printf("Mineracao: filtro prof %d x %d thread(s), verificacao prof %d x %d thread(s)\n",
+           mine_filter_depth, nf, AI_DEPTH, nv);
+    fflush(stdout);
+
+    long long t0 = now_ms();
+    MinePos p;
+    char tok[64];
+    int game_end, skip = 0;
+    p.game = 1;
+    p.ply = 0;
+    init_board(&p.bd);
+    p.white_turn = 1;
+    for (;;) {
+        int got = pgn_next_token(&in, tok, sizeof tok, &game_end);
+        if (game_end || !got) {
+            if (p.ply > 0) { atomic_fetch_add(&miner.games, 1); p.game++; }
+            p.ply = 0;
+            skip = 0;
+            init_board(&p.bd);
+            p.white_turn = 1;
+            if (!got) break;
+            continue;
+        }
+        if (skip) continue;
+        Move legal[MAX_MOVES];
+        int nl = generate_legal_moves(&p.bd, legal, p.white_turn), found = -1;
+        for (int i=0;i<nl && found < 0;i++) if (move_matches_text(&p.bd, p.white_turn, legal[i], tok)) found = i;
+        if (found < 0) { skip = 1; continue; } /* lance ilegal ou sem suporte (roque): descarta o resto */
+        apply_move(&p.bd, legal[found]);
+        p.white_turn = !p.white_turn;
+        p.ply++;
+        if (p.ply >= MINE_MIN_PLY) {
+            atomic_fetch_add(&miner.positions_seen, 1);
+            mq_push(&miner.positions, &p);
+        }
+    }
+    pgn_close(&in);
+    mq_producer_done(&miner.positions);
+    for (int t=0;t<nf+nv;t++) pthread_join(tids[t], NULL);
+    fclose(miner.out);
+    free(miner.seen);
+    long long ms = now_ms() - t0;
+    printf("Partidas %lld, posicoes %lld (%lld repetidas), candidatas %lld, problemas %lld em %lld ms (%.0f posicoes/s)\n",
+           (long long)miner.games, (long long)miner.positions_seen, (long long)atomic_load(&dedup.duplicates), (long long)miner.filtered,
+           (long long)miner.puzzles, ms, ms ? miner.positions_seen * 1000.0 / ms : 0.0);
+    return 0;
+}
+
+/* Análise longa com checkpoint: busca a posição até --depth (sem limite de tempo nem paradas
+   por estabilidade) e grava o estado retomável a cada iteração completa e a cada
+   --checkpoint-interval segundos: progresso da raiz (scores, nós e jogadas já feitas na
+   iteração corrente), linha principal, killers/histórico e, com --checkpoint-hash, o hash.
+   Com --resume, um processo novo continua da iteração em que o anterior parou. */
+const char *checkpoint_path = NULL; /* --checkpoint ARQUIVO */
+int checkpoint_interval_s = 60;     /* --checkpoint-interval S */
+int checkpoint_hash = 0;            /* --checkpoint-hash */
+int checkpoint_resume = 0;          /* --resume */
+
+#define CHECKPOINT_MAGIC "XADRCKP1"
+typedef struct {
+    char magic[8];
+    long long nodes;                /* nós acumulados de todas as sessões */
+    long long elapsed_ms;
+    int pv_len;
+    Move pv[MAX_PLY];
+    int has_tables;
+    int has_hash;
+    unsigned long long tt_entries;
+    int tt_generation;
+} CheckpointHeader;
+
+struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int quit;
+    long long base_nodes, base_ms, start_ms;
+    int nthreads;
+    int has_tables;
+    ThreadTables tables;  /* killers/histórico da thread 0 na última iteração completa */
+} analysis = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+long long analysis_nodes(void) {
+    long long n = analysis.base_nodes;
+    for (int t=0;t<analysis.nthreads;t++) n += search_threads[t].nodes;
+    return n;
+}
+
+/* Linha principal pelo hash, a partir da melhor jogada da última iteração completa */
+int analysis_pv(RootProgress *rp, Move *pv) {
+    if (rp->reached == 0) return 0;
+    SearchThread view;
+    memset(&view, 0, sizeof view);
+    view.tt = tt_table;
+    view.tt_mask = tt_entries - 1;
+    Board b;
+    copy_board(&b, &rp->bd);
+    int side = rp->white_turn, len = 0;
+    Move m = rp->best;
+    while (len < rp->reached && len < MAX_PLY) {
+        pv[len++] = m;
+        apply_move(&b, m);
+        side = !side;
+        int sc, d, f;
+        Move next, legal;
+        if (!tt_probe(&view, board_hash(&b, side), &sc, &d, &f, &next) || !find_legal_move(&b, side, next, &legal)) break;
+        m = legal;
+    }
+    return len;
+}
+
+/* Grava o checkpoint (arquivo temporário + rename); chamada com analysis.lock. O progresso
+   da raiz é copiado sob root_progress_lock; as tabelas da thread 0, que ela altera a cada nó,
+   vêm da cópia feita no fim da última iteração; o hash vai como está, pois cada entrada se
+   valida pela chave (key ^ data) e uma entrada rasgada apenas deixa de ser encontrada. */
+void checkpoint_write(void) {
+    static RootProgress snap;
+    pthread_mutex_lock(&root_progress_lock);
+    memcpy(&snap, &root_progress, sizeof snap);
+    pthread_mutex_unlock(&root_progress_lock);
+    CheckpointHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, CHECKPOINT_MAGIC, 8);
+    h.nodes = analysis_nodes();
+    h.elapsed_ms = analysis.base_ms + now_ms() - analysis.start_ms;
+    h.pv_len = analysis_pv(&snap, h.pv);
+    h.has_tables = analysis.has_tables;
+    h.has_hash = checkpoint_hash && tt_table;
+    h.tt_entries = tt_entries;
+    h.tt_generation = tt_generation;
+    char tmp[4096];
+    snprintf(tmp, sizeof tmp, "%s.tmp", checkpoint_path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { fprintf(stderr, "Checkpoint: nao foi possivel criar %s\n", tmp); return; }
+    int ok = fwrite(&h, sizeof h, 1, f) == 1 && fwrite(&snap, sizeof snap, 1, f) == 1;
+    if (ok && h.has_tables) ok = fwrite(&analysis.tables, sizeof(ThreadTables), 1, f) == 1;
+    if (ok && h.has_hash) ok = fwrite(tt_table, sizeof(TTEntry), tt_entries, f) == tt_entries;
+    if (fclose(f) != 0 || !ok || rename(tmp, checkpoint_path) != 0) fprintf(stderr, "Checkpoint: falha ao gravar\n");
+}
+
+/* Lê um checkpoint; restaura o hash se foi salvo com o mesmo tamanho */
+int checkpoint_load(const char *path, CheckpointHeader *h, RootProgress *rp, ThreadTables *tables) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    int ok = fread(h, sizeof *h, 1, f) == 1 && !memcmp(h->magic, CHECKPOINT_MAGIC, 8) && fread(rp, sizeof *rp, 1, f) == 1;
+    if (ok && h->has_tables) ok = fread(tables, sizeof *tables, 1, f) == 1;
+    if (ok && h->has_hash) {
+        if (h->tt_entries == tt_entries) {
+            ok = fread(tt_table, sizeof(TTEntry), tt_entries, f) == tt_entries;
+            tt_generation = h->tt_generation;
+            tt_needs_touch = 0;
+        } else {
+            fprintf(stderr, "Checkpoint: hash salvo com outro tamanho, ignorado\n");
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+void analysis_iteration(void) {
+    RootProgress *rp = &root_progress;
+    Move pv[MAX_PLY];
+    pthread_mutex_lock(&analysis.lock);
+    int len = analysis_pv(rp, pv);
+    printf("prof %d score %d nos %lld tempo %lld ms pv", rp->reached, rp->best_score, analysis_nodes(),
+           analysis.base_ms + now_ms() - analysis.start_ms);
+    for (int i=0;i<len;i++) { char ms[8]; move_to_str(pv[i], ms); printf(" %s", ms); }
+    printf("\n");
+    fflush(stdout);
+    /* entre iterações a thread 0 (que chama o gancho) não mexe nas próprias tabelas */
+    if (search_threads[0].local) {
+        memcpy(&analysis.tables, search_threads[0].local, sizeof(ThreadTables));
+        analysis.has_tables = 1;
+    }
+    if (checkpoint_path) checkpoint_write();
+    pthread_mutex_unlock(&analysis.lock);
+}
+
+void *checkpoint_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&analysis.lock);
+    while (!analysis.quit) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += checkpoint_interval_s > 0 ? checkpoint_interval_s : 60;
+        if (pthread_cond_timedwait(&analysis.wake, &analysis.lock, &ts) == ETIMEDOUT && !analysis.quit) checkpoint_write();
+    }
+    pthread_mutex_unlock(&analysis.lock);
+    return NULL;
+}
+
+int run_analyze(void) {
+    Board bd;
+    int wt;
+    static RootProgress saved;
+    static ThreadTables saved_tables;
+    CheckpointHeader h;
+    int resumed = 0;
+    if (checkpoint_resume && checkpoint_path && checkpoint_load(checkpoint_path, &h, &saved, &saved_tables)) {
+        Board given;
+        int gwt;
+        if (analysis_fen && (!parse_fen(analysis_fen, &given, &gwt) || gwt != saved.white_turn || memcmp(&given, &saved.bd, sizeof given))) {
+            fprintf(stderr, "Checkpoint de outra posicao: ignorado\n");
+        } else {
+            resumed = 1;
+            copy_board(&bd, &saved.bd);
+            wt = saved.white_turn;
+            analysis.base_nodes = h.nodes;
+            analysis.base_ms = h.elapsed_ms;
+            search_resume = &saved;
+            resume_tables = h.has_tables ? &saved_tables : NULL;
+            if (h.has_tables) {
+                memcpy(&analysis.tables, &saved_tables, sizeof saved_tables);
+                analysis.has_tables = 1;
+            }
+            int done = 0;
+            for (int i=0; saved.depth > saved.reached && i<saved.n; i++) done += saved.done[i];
+            printf("Retomando: prof %d completa, %d/%d jogadas feitas na prof %d, %lld nos, %lld ms%s\n",
+                   saved.reached, done, saved.n, saved.reached + 1, h.nodes, h.elapsed_ms,
+                   h.has_hash && h.tt_entries == tt_entries ? ", hash restaurado" : "");
+            fflush(stdout);
+        }
+    }
+    if (!resumed && analysis_fen) {
+        if (!parse_fen(analysis_fen, &bd, &wt)) { fprintf(stderr, "FEN invalido\n"); return 1; }
+    } else if (!resumed) {
+        init_board(&bd);
+        wt = 1;
+    }
+    if (!opt_depth_set) AI_DEPTH = MAX_PLY - 1;
+    AI_TIME_MS = 0;
+    AI_STABLE_ITERS = INT_MAX;
+    AI_RECAPTURE_MARGIN = INT_MAX;
+    AI_SKILL = SKILL_MAX;
+    search_full = 1;  /* com uma só resposta legal também itera (e grava checkpoints) */
+    analysis.nthreads = AI_THREADS < 1 ? 1 : AI_THREADS > MAX_THREADS ? MAX_THREADS : AI_THREADS;
+    analysis.start_ms = now_ms();
+    iteration_hook = analysis_iteration;
+    pthread_t tid;
+    int ticker = checkpoint_path && pthread_create(&tid, NULL, checkpoint_main, NULL) == 0;
+    SearchInfo info;
+    Move best = search_position(&bd, wt, &info);
+    pthread_mutex_lock(&analysis.lock);
+    analysis.quit = 1;
+    pthread_cond_signal(&analysis.wake);
+    pthread_mutex_unlock(&analysis.lock);
+    if (ticker) pthread_join(tid, NULL);
+    iteration_hook = NULL;
+    char ms[8];
+    move_to_str(best, ms);
+    printf("bestmove %s score %d prof %d\n", ms, root_progress.best_score, root_progress.reached);
+    return 0;
+}
+
+/* Escalabilidade por threads: as mesmas posições na mesma profundidade com 1, 2, 4, ... N
+   threads, com hash e tabelas de ordenação zerados antes de cada busca. Para cada contagem:
+   NPS e ganho sobre 1 thread, ganho no tempo até a profundidade, nós a mais que com 1 thread
+   (sobrecarga de busca), acerto no hash, despejos de entradas vivas de outra posição (disputa
+   pelo hash compartilhado) e ocupação das threads na divisão da raiz. Tabela na saída padrão
+   e JSON em --bench-json. */
+int bench_threads_max = 0;          /* --bench-threads N (0 = threads do contêiner) */
+const char *bench_json_file = NULL; /* --bench-json ARQUIVO ("-" = saída padrão) */
+#define SCALING_DEFAULT_DEPTH 5
+
+typedef struct {
+    int threads;
+    long long nodes, wall_ns, busy_ns;
+    long long probes, hits, stores, evictions;
+} ScalingRow;
+
+int run_bench_threads(void) {
+    int n;
+    char **fens = corpus_load(&n);
+    if (!fens) return 1;
+    int maxt = bench_threads_max > 0 ? bench_threads_max : AI_THREADS;
+    if (maxt > MAX_THREADS) maxt = MAX_THREADS;
+    int counts[8], nc = 0;
+    for (int t=1;t<maxt;t*=2) counts[nc++] = t;
+    counts[nc++] = maxt;
+    if (!opt_depth_set) AI_DEPTH = SCALING_DEFAULT_DEPTH;
+    AI_TIME_MS = 0;
+    AI_NODES = 0;
+    AI_SLO_MS = 0;
+    AI_SKILL = SKILL_MAX;
+    AI_DETERMINISTIC = 0;
+    AI_STABLE_ITERS = INT_MAX;
+    AI_RECAPTURE_MARGIN = INT_MAX;
+    ScalingRow rows[8];
+    printf("profundidade %d, %d posicoes, hash %d MB\n", AI_DEPTH, n, AI_HASH_MB);
+    printf("%7s %12s %9s %10s %9s %11s %11s %8s %9s %8s\n", "threads", "nos", "ms", "NPS", "ganho NPS",
+           "ganho tempo", "sobrecarga", "hash", "despejos", "ocupacao");
+    for (int c=0;c<nc;c++) {
+        ScalingRow *r = &rows[c];
+        memset(r, 0, sizeof *r);
+        r->threads = AI_THREADS = counts[c];
+        for (int i=0;i<n;i++) {
+            Board bd;
+            int wt;
+            SearchInfo info;
+            if (!parse_fen(fens[i], &bd, &wt)) continue;
+            search_state_reset();
+            long long t0 = now_ns();
+            search_position(&bd, wt, &info);
+            r->wall_ns += now_ns() - t0;
+            r->nodes += info.nodes;
+            for (int t=0;t<r->threads;t++) {
+                SearchThread *st = &search_threads[t];
+                r->busy_ns += st->busy_ns;
+                r->probes += st->tt_probes;
+                r->hits += st->tt_hits;
+                r->stores += st->tt_stores;
+                r->evictions += st->tt_evictions;
+            }
+        }
+        double nps = r->wall_ns ? r->nodes * 1e9 / r->wall_ns : 0;
+        double nps1 = rows[0].wall_ns ? rows[0].nodes * 1e9 / rows[0].wall_ns : 0;
+        printf("%7d %12lld %9.0f %10.0f %8.2fx %10.2fx %10.1f%% %7.1f%% %8.2f%% %7.1f%%\n", r->threads, r->nodes,
+               r->wall_ns / 1e6, nps, nps1 ? nps / nps1 : 0.0, r->wall_ns ? (double)rows[0].wall_ns / r->wall_ns : 0.0,
+               rows[0].nodes ? 100.0 * (r->nodes - rows[0].nodes) / rows[0].nodes : 0.0,
+               r->probes ? 100.0 * r->hits / r->probes : 0.0, r->stores ? 100.0 * r->evictions / r->stores : 0.0,
+               r->wall_ns ? 100.0 * r->busy_ns / ((double)r->wall_ns * r->threads) : 0.0);
+        fflush(stdout);
+    }
+    if (!bench_json_file) return 0;
+    FILE *f = strcmp(bench_json_file, "-") ? fopen(bench_json_file, "w") : stdout;
+    if (!f) { fprintf(stderr, "Nao foi possivel abrir %s\n", bench_json_file); return 1; }
+    fprintf(f, "{\"depth\": %d, \"positions\": %d, \"hash_mb\": %d, \"runs\": [", AI_DEPTH, n, AI_HASH_MB);
+    for (int c=0;c<nc;c++) {
+        ScalingRow *r = &rows[c];
+        double nps = r->wall_ns ? r->nodes * 1e9 / r->wall_ns : 0;
+        double nps1 = rows[0].wall_ns ? rows[0].nodes * 1e9 / rows[0].wall_ns : 0;
+        fprintf(f, "%s\n  {\"threads\": %d, \"nodes\": %lld, \"time_ms\": %.3f, \"nps\": %.0f, \"nps_speedup\": %.4f, "
+                   "\"time_to_depth_speedup\": %.4f, \"search_overhead\": %.4f, \"tt_hit_rate\": %.4f, "
+                   "\"tt_eviction_rate\": %.4f, \"utilization\": %.4f}",
+                c ? "," : "", r->threads, r->nodes, r->wall_ns / 1e6, nps, nps1 ? nps / nps1 : 0.0,
+                r->wall_ns ? (double)rows[0].wall_ns / r->wall_ns : 0.0,
+                rows[0].nodes ? (double)(r->nodes - rows[0].nodes) / rows[0].nodes : 0.0,
+                r->probes ? (double)r->hits / r->probes : 0.0, r->stores ? (double)r->evictions / r->stores : 0.0,
+                r->wall_ns ? r->busy_ns / ((double)r->wall_ns * r->threads) : 0.0);
+    }
+    fprintf(f, "\n]}\n");
+    if (f != stdout) fclose(f);
+    return 0;
+}
+
+/* Geração incremental contra regeneração completa: perft nas posições do corpus pelos dois
+   caminhos (contagens iguais ou a diferença é apontada) e a mesma busca com e sem
+   --incremental-moves, que deve visitar os mesmos nós. Antes do corpus, as posições de
+   borda abaixo passam pelos dois caminhos em perft 2; qualquer diferença falha o modo. */
+int perft_depth = 3; /* --perft N */
+static const char *movegen_edge_fens[] = {
+    "Q2QQQ2/Q1Q3QQ/Q3Q3/1Q5Q/Q6Q/Q1Q1Q3/Q5QQ/1Q1QKQ1k w - - 0 1", /* mais de MAX_MOVES pseudo-legais */
+};
+
+long long perft_full(Board *bd, int white_turn, int depth) {
+    Move moves[MAX_MOVES];
+    int n = generate_legal_moves(bd, moves, white_turn);
+    if (depth <= 1) return n;
+    long long total = 0;
+    Board tmp;
+    for (int i=0;i<n;i++) {
+        copy_board(&tmp, bd);
+        apply_move(&tmp, moves[i]);
+        total += perft_full(&tmp, !white_turn, depth - 1);
+    }
+    return total;
+}
+
+long long perft_cached(MoveCache *mc, Board *bd, int white_turn, int depth) {
+    Move moves[MAX_MOVES];
+    int n = movecache_legal_moves(mc, bd, moves, white_turn);
+    if (depth <= 1) return n;
+    long long total = 0;
+    Board tmp;
+    for (int i=0;i<n;i++) {
+        copy_board(&tmp, bd);
+        apply_move(&tmp, moves[i]);
+        movecache_update(mc + 1, mc, &tmp, moves[i]);
+        total += perft_cached(mc + 1, &tmp, !white_turn, depth - 1);
+    }
+    return total;
+}
+
+int run_bench_movegen(void) {
+    int n;
+    char **fens = corpus_load(&n);
+    if (!fens) return 1;
+    if (perft_depth < 1 || perft_depth >= MAX_PLY) perft_depth = 3;
+    if (!opt_depth_set) AI_DEPTH = 4;
+    static MoveCache stack[MAX_PLY];
+    long long t_full = 0, t_inc = 0, leaves = 0, search_ns[2] = {0, 0}, nodes[2] = {0, 0};
+    int mismatches = 0;
+    for (int i=0;i<(int)(sizeof movegen_edge_fens / sizeof *movegen_edge_fens);i++) {
+        Board bd;
+        int wt;
+        if (!parse_fen(movegen_edge_fens[i], &bd, &wt)) continue;
+        movecache_build(&stack[0], &bd);
+        long long a = perft_full(&bd, wt, 2), b = perft_cached(stack, &bd, wt, 2);
+        if (a != b) { printf("borda %d: perft 2 %lld completa, %lld incremental\n", i + 1, a, b); mismatches++; }
+    }
+    printf("perft %d\n%-4s %12s %9s %9s\n", perft_depth, "pos", "folhas", "ms", "ms inc");
+    for (int i=0;i<n;i++) {
+        Board bd;
+        int wt;
+        if (!parse_fen(fens[i], &bd, &wt)) { printf("%-4d FEN invalido\n", i + 1); continue; }
+        long long t0 = now_ns();
+        long long a = perft_full(&bd, wt, perft_depth);
+        long long t1 = now_ns();
+        movecache_build(&stack[0], &bd);
+        long long b = perft_cached(stack, &bd, wt, perft_depth);
+        long long t2 = now_ns();
+        t_full += t1 - t0;
+        t_inc += t2 - t1;
+        leaves += a;
+        mismatches += a != b;
+        printf("%-4d %12lld %9.1f %9.1f%s\n", i + 1, a, (t1 - t0) / 1e6, (t2 - t1) / 1e6, a == b ? "" : "  (contagem difere)");
+        fflush(stdout);
+    }
+    printf("perft: %.2f M folhas/s completa, %.2f M folhas/s incremental (%.2fx)\n",
+           t_full ? leaves * 1e3 / t_full : 0.0, t_inc ? leaves * 1e3 / t_inc : 0.0, t_inc ? (double)t_full / t_inc : 0.0);
+    AI_THREADS = 1;
+    AI_TIME_MS = 0;
+    AI_NODES = 0;
+    AI_STABLE_ITERS = INT_MAX;
+    AI_RECAPTURE_MARGIN = INT_MAX;
+    for (int i=0;i<n;i++) {
+        Board bd;
+        int wt;
+        SearchInfo info;
+        if (!parse_fen(fens[i], &bd, &wt)) continue;
+        for (int inc=0;inc<2;inc++) {
+            AI_INCREMENTAL_MOVES = inc;
+            search_state_reset();
+            long long t0 = now_ns();
+            search_position(&bd, wt, &info);
+            search_ns[inc] += now_ns() - t0;
+            nodes[inc] += info.nodes;
+        }
+    }
+    printf("busca prof %d: %.0f ms completa, %.0f ms incremental (%.2fx), nos %lld / %lld%s\n", AI_DEPTH,
+           search_ns[0] / 1e6, search_ns[1] / 1e6, search_ns[1] ? (double)search_ns[0] / search_ns[1] : 0.0, nodes[0], nodes[1],
+           nodes[0] == nodes[1] ? "" : " (difere)");
+    return mismatches != 0;
+}
+
+/* Vazão e taxa real de falsos positivos do filtro: AI_THREADS threads inserem N chaves
+   aleatórias num filtro dimensionado para N, depois N chaves nunca inseridas são testadas */
+long long bench_dedup_keys = 0; /* --bench-dedup N */
+
+void *bench_dedup_main(void *arg) {
+    long t = (long)arg, nt = AI_THREADS < 1 ? 1 : AI_THREADS;
+    unsigned long long s = 0x1234 + t;
+    for (long long i=t;i<bench_dedup_keys;i+=nt) {
+        s = 0x1234 + i;
+        dedup_test(splitmix64(&s), 1);
+    }
+    return NULL;
+}
+
+int run_bench_dedup(void) {
+    if (bench_dedup_keys < 1) { fprintf(stderr, "Numero de chaves invalido: %lld\n", bench_dedup_keys); return 1; }
+    int nt = AI_THREADS < 1 ? 1 : AI_THREADS > MAX_THREADS ? MAX_THREADS : AI_THREADS;
+    if (!dedup_create(bench_dedup_keys, dedup_fp)) { fprintf(stderr, "Sem memoria para o filtro de dedup\n"); return 1; }
+    printf("%lld chaves, alvo %.4f%%: %llu KB (%.1f bits/chave), k=%d, %d thread(s)\n", bench_dedup_keys, dedup_fp * 100,
+           dedup.blocks * DEDUP_BLOCK_WORDS * 8 >> 10, dedup.blocks * 512.0 / bench_dedup_keys, dedup.k, nt);
+    pthread_t tids[MAX_THREADS];
+    long long t0 = now_ns();
+    for (int t=0;t<nt;t++) pthread_create(&tids[t], NULL, bench_dedup_main, (void *)(long)t);
+    for (int t=0;t<nt;t++) pthread_join(tids[t], NULL);
+    long long t1 = now_ns();
+    long long fp = 0;
+    for (long long i=0;i<bench_dedup_keys;i++) {
+        unsigned long long s = 0x9876543210ULL + i * 0x2545F4914F6CDD1DULL;
+        fp += !dedup_test(splitmix64(&s) ^ 0xA5A5A5A5A5A5A5A5ULL, 0);
+    }
+    long long t2 = now_ns();
+    printf("insercao %.1f M/s, consulta %.1f M/s, falsos positivos %.4f%%, inseridas como novas %lld\n",
+           bench_dedup_keys * 1e3 / (t1 - t0), bench_dedup_keys * 1e3 / (t2 - t1),
+           100.0 * fp / bench_dedup_keys, (long long)atomic_load(&dedup.inserted));
+    return 0;
+}
+
+/* Opções de linha de comando */
+void parse_options(int argc, char **argv) {
+    prog_argc = argc;
+    prog_argv = argv;
+    for (int i=1;i<argc;i++) {
+        const char *a = argv[i];
+        const char *v = i+1 < argc ? argv[i+1] : NULL;
+        if (!strcmp(a, "--depth") && v) { AI_DEPTH = atoi(v); opt_depth_set = 1; i++; }
+        else if (!strcmp(a, "--time") && v) { AI_TIME_MS = atoi(v); i++; }
+        else if (!strcmp(a, "--threads") && v) { AI_THREADS = atoi(v); opt_threads_set = 1; i++; }
+        else if (!strcmp(a, "--hash") && v) { AI_HASH_MB = atoi(v); opt_hash_set = 1; i++; }
+        else if (!strcmp(a, "--nodes") && v) { AI_NODES = atoll(v); i++; }
+        else if (!strcmp(a, "--deterministic")) AI_DETERMINISTIC = 1;
+        else if (!strcmp(a, "--no-numa")) AI_NUMA = 0;
+        else if (!strcmp(a, "--fill-attacks")) AI_FILL_ATTACKS = 1;
+        else if (!strcmp(a, "--mtdf")) AI_MTDF = 1;
+        else if (!strcmp(a, "--policy") && v) { policy_file = v; i++; }
+        else if (!strcmp(a, "--policy-min-depth") && v) { AI_POLICY_MIN_DEPTH = atoi(v); i++; }
+        else if (!strcmp(a, "--policy-data") && v) { policy_data_file = v; i++; }
+        else if (!strcmp(a, "--policy-train") && v) { run_mode = "policy-train"; policy_train_file = v; i++; }
+        else if (!strcmp(a, "--policy-out") && v) { policy_out = v; i++; }
+        else if (!strcmp(a, "--policy-epochs") && v) { policy_epochs = atoi(v); i++; }
+        else if (!strcmp(a, "--compare-mtdf")) run_mode = "compare-mtdf";
+        else if (!strcmp(a, "--corpus") && v) { corpus_file = v; i++; }
+        else if (!strcmp(a, "--bench-threads") && v) { run_mode = "bench-threads"; bench_threads_max = atoi(v); i++; }
+        else if (!strcmp(a, "--bench-json") && v) { bench_json_file = v; i++; }
+        else if (!strcmp(a, "--incremental-moves")) AI_INCREMENTAL_MOVES = 1;
+        else if (!strcmp(a, "--bench-movegen")) run_mode = "bench-movegen";
+        else if (!strcmp(a, "--perft") && v) { perft_depth = atoi(v); i++; }
+        else if (!strcmp(a, "--dedup") && v) { dedup_path = v; i++; }
+        else if (!strcmp(a, "--dedup-capacity") && v) { dedup_capacity = atoll(v); i++; }
+        else if (!strcmp(a, "--dedup-fp") && v) { dedup_fp = atof(v); i++; }
+        else if (!strcmp(a, "--bench-dedup") && v) { run_mode = "bench-dedup"; bench_dedup_keys = atoll(v); i++; }
+        else if (!strcmp(a, "--annotate") && v) { run_mode = "annotate"; annotate_file = v; i++; }
+        else if (!strcmp(a, "--bench-read") && v) { run_mode = "bench-read"; bench_read_file = v; i++; }
+        else if (!strcmp(a, "--no-uring")) bulk_uring_disabled = 1;
+        else if (!strcmp(a, "--analyze")) run_mode = "analyze";
+        else if (!strcmp(a, "--checkpoint") && v) { checkpoint_path = v; i++; }
+        else if (!strcmp(a, "--checkpoint-interval") && v) { checkpoint_interval_s = atoi(v); i++; }
+        else if (!strcmp(a, "--checkpoint-hash")) checkpoint_hash = 1;
+        else if (!strcmp(a, "--resume")) checkpoint_resume = 1;
+        else if (!strcmp(a, "--mine") && v) { run_mode = "mine"; mine_file = v; i++; }
+        else if (!strcmp(a, "--mine-out") && v) { mine_out = v; i++; }
+        else if (!strcmp(a, "--mine-filter-depth") && v) { mine_filter_depth = atoi(v); i++; }
+        else if (!strcmp(a, "--mine-filter-threads") && v) { mine_filter_threads = atoi(v); i++; }
+        else if (!strcmp(a, "--mine-verify-threads") && v) { mine_verify_threads = atoi(v); i++; }
+        else if (!strcmp(a, "--skill") && v) { AI_SKILL = atoi(v); i++; }
+        else if (!strcmp(a, "--slo") && v) { AI_SLO_MS = atoi(v); i++; }
+        else if (!strcmp(a, "--min-scale") && v) { AI_LOAD_MIN_SCALE = atof(v); i++; }
+        else if (!strcmp(a, "--min-depth") && v) { AI_LOAD_MIN_DEPTH = atoi(v); i++; }
+        else if (!strcmp(a, "--bench-dispatch")) run_mode = "bench-dispatch";
+        else if (!strcmp(a, "--server") && v) { run_mode = "server"; server_path = v; i++; }
+        else if (!strcmp(a, "--server-tcp") && v) { run_mode = "server"; server_port = atoi(v); i++; }
+        else if (!strcmp(a, "--distribute") && v) { run_mode = "distribute"; dist_workers = v; i++; }
+        else if (!strcmp(a, "--dist-bench") && v) { run_mode = "dist-bench"; dist_bench_workers = atoi(v); i++; }
+        else if (!strcmp(a, "--fen") && v) { analysis_fen = v; i++; }
+        else if (!strcmp(a, "--epd") && v) { run_mode = "epd"; epd_file = v; i++; }
+        else if (!strcmp(a, "--epd-jobs") && v) { epd_jobs = atoi(v); i++; }
+        else if (!strcmp(a, "--epd-worker") && v && sscanf(v, "%d:%d", &epd_counter_fd, &epd_out_fd) == 2) { run_mode = "epd-worker"; i++; }
+        else if (!strcmp(a, "--metrics-file") && v) { metrics_file = v; i++; }
+        else if (!strcmp(a, "--metrics-interval") && v) { metrics_interval_ms = atoi(v); i++; }
+        else if (!strcmp(a, "--metrics-port") && v) { metrics_port = atoi(v); i++; }
+        else { fprintf(stderr, "Opcao desconhecida: %s\n", a); exit(1); }
+    }
+    if (AI_MTDF && opt_threads_set && AI_THREADS > 1) fprintf(stderr, "--mtdf busca em uma thread: --threads ignorado\n");
+    if (AI_MTDF && AI_SKILL < SKILL_MAX) fprintf(stderr, "--mtdf com --skill abaixo de %d: usando a busca normal\n", SKILL_MAX);
+}
+
+/* Main loop */
+int main(int argc, char **argv) {
+    parse_options(argc, argv);
+    flight_start(); /* antes de qualquer outra thread, para todas herdarem o SIGUSR1 bloqueado */
+    apply_resource_defaults();
+    srand((unsigned)time(NULL));
+    if (!strcmp(run_mode, "bench-dispatch")) return bench_dispatch();
+    if (!strcmp(run_mode, "bench-read")) return run_bench_read();
+    if (!strcmp(run_mode, "bench-dedup")) return run_bench_dedup();
+    if (!dedup_open()) return 1;
+    if (!strcmp(run_mode, "policy-train")) return run_policy_train();
+    if (policy_file && !policy_load(policy_file)) { fprintf(stderr, "Pesos de politica invalidos: %s\n", policy_file); return 1; }
+    if (policy_data_file && !(policy_data = fopen(policy_data_file, "ab"))) {
+        fprintf(stderr, "Nao foi possivel abrir %s\n", policy_data_file);
+        return 1;
+    }
+    tt_resize(AI_HASH_MB);
+    if (!strcmp(run_mode, "epd-worker")) return run_epd_worker(); /* métricas ficam com o pai */
+    metrics_start();
+    if (!strcmp(run_mode, "server")) return run_server();
+    if (!strcmp(run_mode, "distribute")) return run_distributed();
+    if (!strcmp(run_mode, "dist-bench")) return run_dist_bench();
+    if (!strcmp(run_mode, "epd")) return run_epd();
+    if (!strcmp(run_mode, "compare-mtdf")) return run_compare_mtdf();
+    if (!strcmp(run_mode, "bench-threads")) return run_bench_threads();
+    if (!strcmp(run_mode, "bench-movegen")) return run_bench_movegen();
+    if (!strcmp(run_mode, "annotate")) return run_annotate();
+    if (!strcmp(run_mode, "mine")) return run_mine();
+    if (!strcmp(run_mode, "analyze")) return run_analyze();
+    Board bd;
+    init_board(&bd);
+    int white_turn = 1; /* humano joga brancas inicialmente */
+    char input[64];
+
+    printf("Bem-vindo ao MateCheck (versao simplificada) — Jogador = Brancas\n");
+    printf("Formato de entrada: e2e4 ou e2 e4. Para sair, digite 'quit'; nova partida: 'new'; nivel: 'skill 0..20'.\n");
+    printf("Nota: sem roque e sem en-passant. Promocao para Q/R/B/N.\n\n");
+
+    while (1) {
+        print_board(&bd);
+        /* checar fim de jogo */
+        Move legalMoves[MAX_MOVES];
+        int nmoves = generate_legal_moves(&bd, legalMoves, white_turn);
+        if (nmoves == 0) {
+            if (is_in_check(&bd, white_turn)) {
+                if (white_turn) printf("XEQUE-MATE! Pretas vencem.\n"); else printf("XEQUE-MATE! Brancas vencem.\n");
+            } else {
+                printf("Empate por stalemate!\n");
+            }
+            break;
+        }
+        if (bd.halfmove >= 100) { printf("Empate pela regra dos 50 lances!\n"); break; }
+        if (insufficient_material(&bd)) { printf("Empate por material insuficiente!\n"); break; }
+
+        if (white_turn) {
+            /* jogador humano */
+            printf("\nSua vez (brancas). Entre sua jogada: ");
+            if (!fgets(input, sizeof(input), stdin)) break;
             if (strncmp(input, "quit", 4) == 0) { printf("Saindo...\n"); break; }
+            if (strncmp(input, "new", 3) == 0) {
+                /* nova partida: o hash é invalidado em O(1) pela troca de geração */
+                init_board(&bd);
+                white_turn = 1;
+                tt_new_generation();
+                printf("Nova partida.\n\n");
+                continue;
+            }
+            if (strncmp(input, "skill", 5) == 0) {
+                int lv = atoi(input + 5);
+                AI_SKILL = lv < 0 ? 0 : lv > SKILL_MAX ? SKILL_MAX : lv;
+                printf("Nivel da maquina: %d\n", AI_SKILL);
+                continue;
+            }
+            if (strncmp(input, "clearhash", 9) == 0) { tt_clear(); printf("Tabela de hash zerada.\n"); continue; }
+            if (strncmp(input, "flight", 6) == 0) { flight_dump(stdout); continue; }
             Move m;
             if (!parse_move_input(input, &m)) { printf("Entrada invalida. Use e2e4.\n"); continue; }
             /* find matching legal move (consider promotions) */